@@ -9,15 +9,39 @@ LOCAL_SRC_FILES := \
     main.cpp \
     geometry.cpp \
     geometry.hpp \
+    hit_test.cpp \
+    hit_test.hpp \
+    latency.cpp \
+    latency.hpp \
+    layer_cache.cpp \
+    layer_cache.hpp \
     stb_vorbis.cpp \
     stb_vorbis.hpp \
+    arena.hpp \
+    constexpr_math.hpp \
+    shape_table.cpp \
+    shape_table.hpp \
     audio.cpp \
     audio.hpp \
+    benchmark.cpp \
+    benchmark.hpp \
+    dynamic_resolution.cpp \
+    dynamic_resolution.hpp \
     font.cpp \
     font.hpp \
+    frame_pacer.cpp \
+    frame_pacer.hpp \
+    frame_scheduler.cpp \
+    frame_scheduler.hpp \
     gl_helper.cpp \
     gl_helper.hpp \
-    log.hpp
+    log.hpp \
+    mesh_optimize.cpp \
+    mesh_optimize.hpp \
+    render_queue.cpp \
+    render_queue.hpp \
+    view.cpp \
+    view.hpp
  
 SDL_PATH := ../SDL  # SDL \
 
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+#include "log.hpp"
+
+// Bump allocator for scratch geometry.
+// One heap block for its whole life, allocations are given back all at once by rewinding (see ArenaScope).
+// Nothing is destructed, so only use it for trivially destructible types.
+struct Arena {
+    std::unique_ptr<std::byte[]> buffer;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t peak = 0;  // high water mark of used
+
+    explicit Arena(size_t bytes) : buffer(new std::byte[bytes]), capacity(bytes) {}
+
+    // alloc aborts when this is false
+    template <typename T>
+    bool fits(size_t count) const {
+        return aligned_offset<T>() + sizeof(T) * count <= capacity;
+    }
+
+    template <typename T>
+    std::span<T> alloc(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>);
+
+        size_t offset = aligned_offset<T>();
+
+        if (offset + sizeof(T) * count > capacity) {
+            LOG("arena out of memory, %d bytes requested with %d of %d used",
+                static_cast<int>(sizeof(T) * count),
+                static_cast<int>(used),
+                static_cast<int>(capacity));
+            std::abort();
+        }
+
+        used = offset + sizeof(T) * count;
+        peak = std::max(peak, used);
+
+        T *p = reinterpret_cast<T *>(buffer.get() + offset);
+        std::uninitialized_default_construct_n(p, count);
+
+        return {p, count};
+    }
+
+    template <typename T>
+    size_t aligned_offset() const {
+        return (used + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+};
+
+// Frees everything allocated from the arena during its lifetime
+struct ArenaScope {
+    Arena &arena;
+    size_t mark;
+
+    explicit ArenaScope(Arena &a) : arena(a), mark(a.used) {}
+    ~ArenaScope() { arena.used = mark; }
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+};
@@ -15,6 +15,27 @@ void Audio::play() {
     }
 }
 
+namespace {
+void loop_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount) {
+    (void)additional_amount;
+    (void)total_amount;
+
+    const Audio &audio = *static_cast<const Audio *>(userdata);
+
+    // keep a whole loop queued ahead
+    if (SDL_GetAudioStreamAvailable(stream) < static_cast<int>(audio.data.size())) {
+        SDL_PutAudioStreamData(stream, audio.data.data(), static_cast<int>(audio.data.size()));
+    }
+}
+}  // namespace
+
+void Audio::loop() {
+    if (stream) {
+        SDL_SetAudioStreamGetCallback(stream, loop_callback, this);
+        play();
+    }
+}
+
 namespace {
 std::vector<uint8_t> change_volume(const std::vector<uint8_t> &data, SDL_AudioSpec spec, float volume) {
     std::vector<uint8_t> ret(data.size());
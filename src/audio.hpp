@@ -11,6 +11,10 @@ struct Audio {
     std::vector<uint8_t> data;
 
     void play();
+
+    // Play over and over. SDL's audio thread queues the next loop, so it keeps going while nothing is rendered.
+    // The Audio must stay at the same address while it plays.
+    void loop();
 };
 
 std::optional<Audio> load_ogg(SDL_AudioDeviceID audio_device, const char *path, float volume = 1.0f);
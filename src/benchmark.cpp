@@ -0,0 +1,109 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <numeric>
+#include <sstream>
+
+#include "log.hpp"
+
+namespace {
+std::atomic<size_t> heap_allocations{0};
+}  // namespace
+
+// Counting replacement for the global allocator, the array and nothrow forms go through this one
+void *operator new(size_t bytes) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *p = std::malloc(bytes > 0 ? bytes : 1);
+
+    if (!p) {
+        LOG("out of memory, %d bytes requested", static_cast<int>(bytes));
+        std::abort();
+    }
+
+    return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+size_t heap_allocation_count() { return heap_allocations.load(std::memory_order_relaxed); }
+
+bool Benchmark::add_frame(float ms) {
+    frame_ms.push_back(ms);
+
+    return static_cast<int>(frame_ms.size()) >= frames;
+}
+
+void Benchmark::add_json(const std::string &key, const std::string &json_value) {
+    entry.emplace_back(key, json_value);
+}
+
+void Benchmark::add_number(const std::string &key, double value) {
+    std::ostringstream ss;
+    ss << value;
+    add_json(key, ss.str());
+}
+
+bool Benchmark::write(const std::string &path) const {
+    std::ofstream out(path);
+
+    if (!out) {
+        LOG("can't write benchmark to %s", path.c_str());
+        return false;
+    }
+
+    out << "{\n";
+    out << "  \"frames\": " << frame_ms.size() << ",\n";
+    out << "  \"frame_ms\": " << json_stats(frame_ms);
+
+    for (const auto &e : entry) {
+        out << ",\n  " << json_string(e.first) << ": " << e.second;
+    }
+
+    out << "\n}\n";
+
+    LOG("benchmark written to %s", path.c_str());
+
+    return true;
+}
+
+std::string json_stats(std::vector<float> value) {
+    if (value.empty()) {
+        return "null";
+    }
+
+    std::sort(value.begin(), value.end());
+
+    auto percentile = [&](float p) {
+        size_t i = static_cast<size_t>(p * static_cast<float>(value.size() - 1) + 0.5f);
+        return value[i];
+    };
+
+    float mean = std::accumulate(value.begin(), value.end(), 0.0f) / static_cast<float>(value.size());
+
+    std::ostringstream ss;
+    ss << "{\"mean\": " << mean << ", \"p50\": " << percentile(0.5f) << ", \"p95\": " << percentile(0.95f)
+       << ", \"p99\": " << percentile(0.99f) << ", \"max\": " << value.back() << "}";
+
+    return ss.str();
+}
+
+std::string json_string(const std::string &str) {
+    std::string ret = "\"";
+
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            ret += '\\';
+        }
+        ret += c;
+    }
+
+    return ret + "\"";
+}
+
+std::string json_bool(bool b) { return b ? "true" : "false"; }
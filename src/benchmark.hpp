@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs the game for a fixed number of frames with vsync off and writes the results as JSON.
+// Enabled with --benchmark on the command line.
+struct Benchmark {
+    bool enabled = false;
+    int frames = 1000;
+
+    std::vector<float> frame_ms;
+
+    // extra "key": value pairs, value is raw JSON
+    std::vector<std::pair<std::string, std::string>> entry;
+
+    // returns true once enough frames are recorded
+    bool add_frame(float ms);
+
+    void add_json(const std::string &key, const std::string &json_value);
+    void add_number(const std::string &key, double value);
+
+    bool write(const std::string &path) const;
+};
+
+// {"mean": ..., "p50": ..., "p95": ..., "p99": ..., "max": ...}
+std::string json_stats(std::vector<float> value);
+std::string json_string(const std::string &str);
+std::string json_bool(bool b);
+
+// Calls to operator new since startup, the difference across a call is what it allocated
+size_t heap_allocation_count();
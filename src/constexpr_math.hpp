@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+// Math usable in constant expressions, std::sin and friends aren't constexpr until C++26.
+// Done in double, good to about 1e-13 which is plenty once rounded to float.
+namespace cx {
+
+constexpr double PI = 3.14159265358979323846;
+
+constexpr double abs(double x) { return x < 0 ? -x : x; }
+
+constexpr double sqrt(double x) {
+    if (x <= 0) {
+        return 0;
+    }
+
+    // Newton's method
+    double r = x > 1 ? x : 1;
+
+    for (int i = 0; i < 100; i++) {
+        double next = 0.5 * (r + x / r);
+
+        if (next == r) {
+            break;
+        }
+
+        r = next;
+    }
+
+    return r;
+}
+
+constexpr double sin(double x) {
+    // reduce to [-pi, pi]
+    x -= static_cast<double>(static_cast<int64_t>(x / (2 * PI))) * 2 * PI;
+
+    if (x > PI) {
+        x -= 2 * PI;
+    } else if (x < -PI) {
+        x += 2 * PI;
+    }
+
+    // Taylor series, the 25th order term is under 1e-12 at pi
+    double term = x;
+    double sum = x;
+
+    for (int n = 1; n <= 12; n++) {
+        term *= -x * x / static_cast<double>((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+
+    return sum;
+}
+
+constexpr double cos(double x) { return sin(x + PI / 2); }
+
+// round half away from zero, like std::round
+constexpr double round(double x) {
+    return x >= 0 ? static_cast<double>(static_cast<int64_t>(x + 0.5))
+                  : -static_cast<double>(static_cast<int64_t>(-x + 0.5));
+}
+
+constexpr double clamp(double x, double lo, double hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
+}  // namespace cx
@@ -0,0 +1,209 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include <sstream>
+#include <vector>
+
+#include "log.hpp"
+
+namespace {
+const char *vertex_shader = R"(#version 300 es
+precision mediump float;
+
+layout(location = 0) in vec2 pos; // clip space
+layout(location = 1) in vec2 uv;
+out vec2 frag_uv;
+
+void main() {
+    gl_Position = vec4(pos, 0.0, 1.0);
+    frag_uv = uv;
+})";
+
+// the texture is premultiplied, bilinear filtering it doesn't bleed the clear color into the edges
+const char *fragment_shader = R"(#version 300 es
+precision mediump float;
+
+uniform sampler2D tex;
+in vec2 frag_uv;
+out vec4 frag_color;
+
+void main() {
+    frag_color = texture(tex, frag_uv);
+})";
+}  // namespace
+
+bool DynamicResolution::init() {
+    shader = make_shader(vertex_shader, fragment_shader);
+
+    if (!shader) {
+        return false;
+    }
+
+    // pos + texture uv
+    std::vector<glm::vec4> vertex{
+        {-1.f, -1.f, 0.f, 0.f}, {1.f, -1.f, 1.f, 0.f}, {1.f, 1.f, 1.f, 1.f}, {-1.f, 1.f, 0.f, 1.f}};
+    quad = make_vertex_buffer(vertex, {0, 1, 2, 0, 2, 3});
+
+    return true;
+}
+
+bool DynamicResolution::finish() {
+    if (!shader->finish()) {
+        return false;
+    }
+
+    shader->use();
+    glUniform1i(shader->get_loc("tex"), 0);
+
+    return true;
+}
+
+void DynamicResolution::resize(int width_, int height_, int samples_) {
+    // init_game goes through resize_event every round
+    if (width_ == width && height_ == height && samples_ == samples) {
+        return;
+    }
+
+    width = width_;
+    height = height_;
+    samples = samples_;
+    target.reset();
+}
+
+void DynamicResolution::set_enabled(bool enabled_) {
+    enabled = enabled_;
+    set_scale(1.0f);
+    probe_frames = DYNRES_PROBE_FRAMES;
+    stepped_up = false;
+
+    LOG("dynamic resolution %s", enabled ? "on" : "off");
+}
+
+void DynamicResolution::set_scale(float new_scale) {
+    new_scale = std::clamp(new_scale, DYNRES_MIN_SCALE, 1.0f);
+
+    if (new_scale != scale) {
+        scale = new_scale;
+        target.reset();
+        changes++;
+    }
+
+    frame_ms = 0;
+    settle = DYNRES_SETTLE_FRAMES;
+    on_budget = 0;
+}
+
+bool DynamicResolution::update(float ms, float budget_ms, bool record) {
+    // waking from idle or a pause, the first full rate interval is still the long throttled one
+    bool skip = !record || throttled;
+    throttled = !record;
+
+    if (!enabled || skip) {
+        return false;
+    }
+
+    frame_ms = frame_ms == 0 ? ms : frame_ms + (ms - frame_ms) * DYNRES_SMOOTHING;
+
+    if (settle > 0) {
+        settle--;
+        return false;
+    }
+
+    if (frame_ms > budget_ms * DYNRES_OVER_BUDGET) {
+        if (scale <= DYNRES_MIN_SCALE) {
+            return false;
+        }
+
+        if (stepped_up) {
+            probe_frames = std::min(probe_frames * 2, DYNRES_MAX_PROBE_FRAMES);
+            stepped_up = false;
+        }
+
+        // rounded to the step, so stepping up later lands on the same scales
+        set_scale(std::round((scale - DYNRES_STEP) / DYNRES_STEP) * DYNRES_STEP);
+        LOG("dynamic resolution: %.1f ms over budget, scale %.1f", static_cast<double>(ms), static_cast<double>(scale));
+        return true;
+    }
+
+    on_budget++;
+
+    if (on_budget < probe_frames || scale >= 1.0f) {
+        return false;
+    }
+
+    // the last step up held, no need to be careful with the next one
+    if (stepped_up) {
+        probe_frames = DYNRES_PROBE_FRAMES;
+    }
+
+    stepped_up = true;
+    set_scale(std::round((scale + DYNRES_STEP) / DYNRES_STEP) * DYNRES_STEP);
+    LOG("dynamic resolution: trying scale %.1f", static_cast<double>(scale));
+
+    return true;
+}
+
+float DynamicResolution::begin(float display_width) {
+    if (!active()) {
+        return display_width;
+    }
+
+    if (!target) {
+        int w = std::max(1, static_cast<int>(std::lround(static_cast<float>(width) * scale)));
+        int h = std::max(1, static_cast<int>(std::lround(static_cast<float>(height) * scale)));
+
+        target = make_render_target(w, h, samples);
+
+        if (!target) {
+            set_enabled(false);
+            return display_width;
+        }
+    }
+
+    target->bind();
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // alpha accumulates coverage instead of being blended like a color
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    return display_width * static_cast<float>(target->texture->width) / static_cast<float>(width);
+}
+
+void DynamicResolution::end() {
+    if (!active() || !target) {
+        return;
+    }
+
+    target->resolve();
+    bind_default_framebuffer(width, height);
+
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    draw_vertex_buffer(shader, quad, target->texture);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+std::string DynamicResolution::json() const {
+    std::ostringstream ss;
+
+    ss << "{\"enabled\": " << (enabled ? "true" : "false") << ", \"scale\": " << scale
+       << ", \"frame_ms\": " << frame_ms << ", \"changes\": " << changes << "}";
+
+    return ss.str();
+}
+
+std::string DynamicResolution::text() const {
+    char buf[128];
+
+    snprintf(buf,
+             sizeof(buf),
+             "dynamic resolution: %s, scale %.1f, %.2f ms",
+             enabled ? "on" : "off",
+             static_cast<double>(scale),
+             static_cast<double>(frame_ms));
+
+    return buf;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "gl_helper.hpp"
+
+// Renders the moving shapes into a smaller target when frames run over budget and upscales it with bilinear
+// filtering. Text and the cached layer stay at window resolution, they're cheap to fill and blur badly.
+//
+// There's no GPU timer in GLES 3.0, so the controller goes by the frame interval. Under vsync that can't show
+// headroom, so once frames have been on budget for a while it tries a step up, and waits longer before the next
+// try every time one doesn't hold.
+
+constexpr float DYNRES_MIN_SCALE = 0.5f;
+constexpr float DYNRES_STEP = 0.1f;
+constexpr float DYNRES_SMOOTHING = 0.1f;       // weight of the newest frame in the smoothed frame time
+constexpr float DYNRES_OVER_BUDGET = 1.15f;    // scale down above this many times the budget
+constexpr int DYNRES_SETTLE_FRAMES = 15;       // after a change, before judging the new scale
+constexpr int DYNRES_PROBE_FRAMES = 120;       // on budget this long before trying a step up
+constexpr int DYNRES_MAX_PROBE_FRAMES = 3840;  // the back off stops doubling here
+
+struct DynamicResolution {
+    bool enabled = false;
+    float scale = 1.0f;  // of the window size, 1 draws straight to the window
+
+    float frame_ms = 0;                 // smoothed, 0 restarts the smoothing
+    int settle = DYNRES_SETTLE_FRAMES;  // frames left before the controller looks at frame_ms again
+    int on_budget = 0;                  // frames in a row
+    int probe_frames = DYNRES_PROBE_FRAMES;
+    bool stepped_up = false;  // the last change was a step up, a step down now means it didn't hold
+    bool throttled = false;   // the last frame wasn't recorded, the next interval would count the throttling
+    uint64_t changes = 0;
+
+    ShaderPtr shader{{}, {}};
+    VertexBufferPtr quad{{}, {}};
+    RenderTargetPtr target{{}, {}};
+
+    int width = 0;  // window pixels
+    int height = 0;
+    int samples = 0;
+
+    bool init();    // starts compiling the shader
+    bool finish();  // waits for it, call before drawing
+
+    // Call on window resize, the target is only remade if the size changed
+    void resize(int width_, int height_, int samples_);
+
+    void set_enabled(bool enabled_);  // off goes back to full resolution
+    void set_scale(float new_scale);
+
+    // Call once per frame with the frame interval, budget is the target frame period. record is false for throttled
+    // and skipped frames, like FramePacer::presented. Returns true if the scale changed.
+    bool update(float ms, float budget_ms, bool record);
+
+    bool active() const { return enabled && scale < 1.0f; }
+
+    // If active, binds the scaled target, clears it to transparent and switches blending so it ends up premultiplied.
+    // Returns the width in pixels the draw area has in it, display_width when not active.
+    float begin(float display_width);
+    void end();  // upscales what was drawn since begin onto the window
+
+    // {"enabled": ..., "scale": ..., "frame_ms": ..., "changes": ...}
+    std::string json() const;
+    std::string text() const;  // one line summary
+};
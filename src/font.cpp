@@ -2,28 +2,33 @@
 
 #include <SDL3/SDL_surface.h>
 
+#include <algorithm>
 #include <glm/gtc/type_ptr.hpp>
 #include <memory>
 #include <sstream>
 
 #include "gl_helper.hpp"
 #include "log.hpp"
+#include "view.hpp"
 
 namespace {
-const char *font_vertex_shader = R"(#version 300 es
-precision mediump float;    
-
+const char *font_vertex_shader = "#version 300 es\nprecision mediump float;\n" VIEW_UNIFORM_GLSL R"(
 layout(location = 0) in vec2 pos;
 layout(location = 1) in vec2 atlas_tex_coord;
 
-uniform mat4 ortho_matrix;
-uniform vec2 trans;
-uniform float font_width;
+uniform float px_range_scale; // distance range in screen pixels per pixel of display width
+uniform float outline_factor;
 out vec2 texCoord;
+flat out float screen_px_range;
+flat out float outline_dist; // screen pixels
 
 void main() {
-    gl_Position = ortho_matrix * vec4(pos*font_width + trans, 0.0, 1.0);
+    gl_Position = ortho_matrix * vec4(pos, 0.0, 1.0);
     texCoord = atlas_tex_coord;
+
+    // constant for the draw, done here rather than per fragment
+    screen_px_range = px_range_scale * display_width;
+    outline_dist = screen_px_range * outline_factor;
 })";
 
 const char *font_fragment_shader = R"(#version 300 es
@@ -34,12 +39,12 @@ out vec4 color;
 uniform sampler2D msdf;
 uniform vec4 bg_color;
 uniform vec4 fg_color;
+flat in float screen_px_range;
+
+#ifdef OUTLINE
 uniform vec4 outline_color;
-uniform float outline_factor;
-uniform float distance_range;
-uniform float grid_width;
-uniform float display_width;
-uniform float font_width;
+flat in float outline_dist;
+#endif
 
 float median(float r, float g, float b) {
     return max(min(r, g), min(max(r, g), b));
@@ -48,34 +53,19 @@ float median(float r, float g, float b) {
 void main() {
     vec3 msd = texture(msdf, texCoord).rgb;
     float sd = median(msd.r, msd.g, msd.b);
-
-    float norm_grid_width = grid_width / display_width;
-    float range_scale = font_width / norm_grid_width;
-
-    float screen_px_range = distance_range * range_scale;
     float dist_px = screen_px_range*(sd - 0.5) + 0.5;
-    float outline_dist = screen_px_range*outline_factor;
-
-    // There's probably some edge case I haven't tested.
-    if (outline_dist > 0.0) {
-        if (dist_px > 0.0 && dist_px < 1.0) { 
-            // inner and start of outline
-            color = mix(outline_color, fg_color, dist_px);
-        } else if (dist_px > -outline_dist && dist_px < -outline_dist + 1.0) {
-            // end of outline and background
-            float opacity = clamp(dist_px + outline_dist, 0.0, 1.0);
-            color = mix(bg_color, outline_color, opacity);
-        } else if (dist_px > -outline_dist && dist_px < 1.0) {
-            color = outline_color;
-        } else {
-            float opacity = clamp(dist_px, 0.0, 1.0);
-            color = mix(bg_color, fg_color, opacity);
-        }
-    } else {
-        float opacity = clamp(dist_px, 0.0, 1.0);
-        color = mix(bg_color, fg_color, opacity);
-    }
+
+#ifdef OUTLINE
+    // fg blends into the outline at the glyph edge, the outline blends into bg outline_dist further out
+    vec4 inner = mix(outline_color, fg_color, clamp(dist_px, 0.0, 1.0));
+    color = mix(bg_color, inner, clamp(dist_px + outline_dist, 0.0, 1.0));
+#else
+    color = mix(bg_color, fg_color, clamp(dist_px, 0.0, 1.0));
+#endif
 })";
+
+const std::vector<std::string> no_outline_defines;
+const std::vector<std::string> outline_defines{"OUTLINE"};
 }  // namespace
 
 bool FontAtlas::load(const std::string &atlas_path, const std::string &atlas_txt) {
@@ -152,7 +142,7 @@ std::pair<glm::vec2, glm::vec2> FontAtlas::get_char_uv(char ch) {
     return {start, end};
 }
 
-std::vector<glm::vec4> FontAtlas::make_letter(float x, float y, char ch) {
+std::array<glm::vec4, 4> FontAtlas::make_letter(float x, float y, char ch) {
     auto [start, end] = get_char_uv(ch);
 
     const Glyph &g = glyph[static_cast<int>(ch)];
@@ -166,124 +156,139 @@ std::vector<glm::vec4> FontAtlas::make_letter(float x, float y, char ch) {
     y += yoff;
 
     // pos + uv
-    return std::vector<glm::vec4>{
-        {x, y, start.x, start.y},
+    return std::array<glm::vec4, 4>{
+        glm::vec4{x, y, start.x, start.y},
         {x + w, y, end.x, start.y},
         {x + w, y - h, end.x, end.y},
         {x, y - h, start.x, end.y},
     };
 }
 
-std::pair<std::vector<glm::vec4>, std::vector<uint32_t>> FontAtlas::make_text_vertex(const std::string &str,
-                                                                                     bool normalize) {
-    float xpos = 0;
+bool FontShader::init() {
+    // compile all the variants up front so there's no hitch when a style is first used
+    no_outline_shader = &variant.get(font_vertex_shader, font_fragment_shader, no_outline_defines);
+    outline_shader = &variant.get(font_vertex_shader, font_fragment_shader, outline_defines);
 
-    std::vector<glm::vec4> vertex_uv;
-    std::vector<uint32_t> index;
+    return *no_outline_shader && *outline_shader;
+}
 
-    uint32_t vertex_count = 0;
+bool FontShader::finish(const FontAtlas &font_atlas) {
+    distance_range = static_cast<float>(font_atlas.distance_range);
+    grid_width = static_cast<float>(font_atlas.grid_width);
 
-    for (char ch : str) {
-        auto v = make_letter(xpos, 0, ch);
+    if (!variant.finish()) {
+        return false;
+    }
 
-        if (normalize) {
-            for (auto &v_ : v) {
-                v_.x /= static_cast<float>(grid_width);
-                v_.y /= static_cast<float>(grid_width);
-            }
-        }
+    for (auto &v : variant.variant) {
+        v.second->use();
+        v.second->bind_uniform_block("View", VIEW_UNIFORM_BINDING);
+        glUniform1i(v.second->get_loc("msdf"), 0);
+    }
 
-        vertex_uv.insert(vertex_uv.end(), v.begin(), v.end());
+    return true;
+}
 
-        const Glyph &g = glyph[static_cast<int>(ch)];
-        xpos += g.advance * em_size;
+const ShaderPtr &FontShader::set_style(const TextStyle &style) {
+    bool outline = style.outline_factor > 0.0f;
 
-        // quad
-        std::vector<uint32_t> idx{0, 1, 2, 0, 2, 3};
-        for (auto &i : idx) {
-            i += vertex_count;
-        }
-        index.insert(index.end(), idx.begin(), idx.end());
+    const ShaderPtr &shader = outline ? *outline_shader : *no_outline_shader;
+    assert(shader->linked);  // by finish()
+    shader->use();
 
-        vertex_count += 4;
+    // screen_px_range = distance_range * font width / normalized grid width,
+    // the display width part is applied in the shader
+    glUniform1f(shader->get_loc("px_range_scale"), distance_range * style.width / grid_width);
+    glUniform4fv(shader->get_loc("fg_color"), 1, glm::value_ptr(style.fg));
+    glUniform4fv(shader->get_loc("bg_color"), 1, glm::value_ptr(style.bg));
+
+    if (outline) {
+        glUniform4fv(shader->get_loc("outline_color"), 1, glm::value_ptr(style.outline));
+        glUniform1f(shader->get_loc("outline_factor"), style.outline_factor);
     }
 
-    return {vertex_uv, index};
+    return shader;
 }
 
-std::pair<VertexBufferPtr, BBox> FontAtlas::make_text(const std::string &str, bool normalize) {
-    auto [vertex_uv, index] = make_text_vertex(str, normalize);
-    return {make_vertex_buffer(vertex_uv, index), bbox(vertex_uv)};
-}
+void TextBatch::init() { vertex_buffer = make_stream_vertex_buffer(); }
+
+void TextBatch::add(
+    FontAtlas &font, const std::string &str, const glm::vec2 &pos, const TextStyle &style, TextAlign align) {
+    if (str.empty()) {
+        return;
+    }
 
-bool FontShader::init(const FontAtlas &font_atlas) {
-    shader = make_shader(font_vertex_shader, font_fragment_shader);
+    auto g = std::find_if(group.begin(), group.end(), [&](const Group &g_) { return g_.style == style; });
+    if (g == group.end()) {
+        group.push_back({style, {}});
+        g = group.end() - 1;
+    }
+
+    size_t start = g->vertex.size();
+    float xpos = 0;
+    float grid_width = static_cast<float>(font.grid_width);
 
-    if (shader) {
-        shader->use();
-        glUniform1i(shader->get_loc("msdf"), 0);
-        set_font_distance_range(static_cast<float>(font_atlas.distance_range));
-        set_font_grid_width(static_cast<float>(font_atlas.grid_width));
+    for (char ch : str) {
+        for (auto v : font.make_letter(xpos, 0, ch)) {
+            v.x /= grid_width;
+            v.y /= grid_width;
+            g->vertex.push_back(v);
+        }
 
-        return true;
+        xpos += font.glyph[static_cast<int>(ch)].advance * font.em_size;
     }
 
-    return false;
-}
+    glm::vec2 offset = pos;
 
-void FontShader::set_trans(const glm::vec2 &trans) const {
-    assert(shader);
-    shader->use();
-    glUniform2fv(shader->get_loc("trans"), 1, glm::value_ptr(trans));
-}
+    if (align == TextAlign::CENTER) {
+        glm::vec2 lo{g->vertex[start].x, g->vertex[start].y};
+        glm::vec2 hi = lo;
 
-void FontShader::set_font_grid_width(float grid_width) const {
-    assert(shader);
-    glUniform1f(shader->get_loc("grid_width"), grid_width);
-}
+        for (size_t i = start; i < g->vertex.size(); i++) {
+            lo = glm::min(lo, glm::vec2{g->vertex[i].x, g->vertex[i].y});
+            hi = glm::max(hi, glm::vec2{g->vertex[i].x, g->vertex[i].y});
+        }
 
-void FontShader::set_font_width(float font_width) const {
-    assert(shader);
-    glUniform1f(shader->get_loc("font_width"), font_width);
-}
+        offset -= (lo + hi) * 0.5f * style.width;
+    }
 
-void FontShader::set_font_distance_range(float range) const {
-    assert(shader);
-    glUniform1f(shader->get_loc("distance_range"), range);
+    for (size_t i = start; i < g->vertex.size(); i++) {
+        g->vertex[i].x = g->vertex[i].x * style.width + offset.x;
+        g->vertex[i].y = g->vertex[i].y * style.width + offset.y;
+    }
 }
 
-void FontShader::set_fg(const glm::vec4 &color) const {
-    assert(shader);
-    shader->use();
-    glUniform4fv(shader->get_loc("fg_color"), 1, glm::value_ptr(color));
-}
+void TextBatch::flush(FontShader &font_shader, const FontAtlas &font) {
+    vertex.clear();
+    index.clear();
 
-void FontShader::set_bg(const glm::vec4 &color) const {
-    assert(shader);
-    shader->use();
-    glUniform4fv(shader->get_loc("bg_color"), 1, glm::value_ptr(color));
-}
+    for (const auto &g : group) {
+        vertex.insert(vertex.end(), g.vertex.begin(), g.vertex.end());
+    }
 
-void FontShader::set_outline(const glm::vec4 &color) const {
-    assert(shader);
-    shader->use();
-    glUniform4fv(shader->get_loc("outline_color"), 1, glm::value_ptr(color));
-}
+    if (vertex.empty()) {
+        return;
+    }
 
-void FontShader::set_outline_factor(float factor) const {
-    assert(shader);
-    shader->use();
-    glUniform1f(shader->get_loc("outline_factor"), factor);
-}
+    // quad per letter
+    for (uint32_t i = 0; i < static_cast<uint32_t>(vertex.size()); i += 4) {
+        for (uint32_t j : {0, 1, 2, 0, 2, 3}) {
+            index.push_back(i + j);
+        }
+    }
 
-void FontShader::set_ortho(const glm::mat4 &ortho) const {
-    assert(shader);
-    shader->use();
-    glUniformMatrix4fv(shader->get_loc("ortho_matrix"), 1, GL_FALSE, glm::value_ptr(ortho));
-}
+    vertex_buffer->stream(glm::value_ptr(vertex[0]), sizeof(glm::vec4) * vertex.size(), index, index16);
 
-void FontShader::set_display_width(float display_width) const {
-    assert(shader);
-    shader->use();
-    glUniform1f(shader->get_loc("display_width"), display_width);
+    size_t index_offset = 0;
+    for (auto &g : group) {
+        size_t index_count = g.vertex.size() / 4 * 6;
+
+        if (index_count > 0) {
+            const ShaderPtr &shader = font_shader.set_style(g.style);
+            draw_vertex_buffer(shader, vertex_buffer, font.tex, index_offset, index_count);
+        }
+
+        index_offset += index_count;
+        g.vertex.clear();
+    }
 }
@@ -2,9 +2,12 @@
 
 #include <SDL3/SDL_opengles2.h>
 
+#include <array>
 #include <glm/glm.hpp>
 #include <map>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "gl_helper.hpp"
 
@@ -33,29 +36,68 @@ struct FontAtlas {
     std::map<int, Glyph> glyph;
 
     bool load(const std::string &atlas_path, const std::string &atlas_txt);
-    std::pair<VertexBufferPtr, BBox> make_text(const std::string &str, bool normalize);
-    std::pair<std::vector<glm::vec4>, std::vector<uint32_t>> make_text_vertex(const std::string &str, bool normalize);
 
     std::pair<glm::vec2, glm::vec2> get_char_uv(char ch);
-    std::vector<glm::vec4> make_letter(float x, float y, char ch);
+    std::array<glm::vec4, 4> make_letter(float x, float y, char ch);
+};
+
+enum class TextAlign { LEFT, CENTER };
+
+struct TextStyle {
+    float width = 1.0f;  // scale applied to the normalized glyphs
+    glm::vec4 fg{};
+    glm::vec4 bg{};
+    glm::vec4 outline{};
+    float outline_factor = 0.0f;
+
+    bool operator==(const TextStyle &) const = default;
 };
 
 struct FontShader {
-    ShaderPtr shader{{}, {}};
+    ShaderCache variant;  // with and without OUTLINE, picked by set_style
+
+    // looked up in variant once by init, set_style only picks between them
+    const ShaderPtr *no_outline_shader = nullptr;
+    const ShaderPtr *outline_shader = nullptr;
+
+    float distance_range = 0.0f;
+    float grid_width = 1.0f;
+
+    bool init();                             // starts compiling the shaders
+    bool finish(const FontAtlas &font_atlas);  // waits for them, call before drawing
+
+    // Select the shader variant for the style and upload its uniforms.
+    // Returns the program to draw with.
+    const ShaderPtr &set_style(const TextStyle &style);
+};
+
+constexpr size_t TEXT_BATCH_INDEX16_BYTES = 16 * 1024;
+
+// Collects all the text submitted during a frame into one streaming vertex buffer.
+// Text sharing the same style is drawn with a single draw call on flush.
+struct TextBatch {
+    struct Group {
+        TextStyle style;
+        std::vector<glm::vec4> vertex;  // pos + texture uv
+    };
+
+    VertexBufferPtr vertex_buffer{{}, {}};
+    std::vector<Group> group;
 
-    bool init(const FontAtlas &font_atlas);
+    // scratch space, kept around to avoid allocating every frame
+    std::vector<glm::vec4> vertex;
+    std::vector<uint32_t> index;
+    Arena index16{TEXT_BATCH_INDEX16_BYTES};  // narrowed indices, longer text falls back to 32 bit
 
-    // call when window resizes
-    void set_ortho(const glm::mat4 &ortho) const;
-    void set_display_width(float display_width) const;
+    void init();
 
-    void set_font_distance_range(float range) const;
-    void set_font_grid_width(float range) const;
-    void set_font_width(float font_width) const;
+    // pos is in normalized units
+    void add(FontAtlas &font,
+             const std::string &str,
+             const glm::vec2 &pos,
+             const TextStyle &style,
+             TextAlign align = TextAlign::LEFT);
 
-    void set_trans(const glm::vec2 &trans) const;
-    void set_fg(const glm::vec4 &color) const;
-    void set_bg(const glm::vec4 &color) const;
-    void set_outline(const glm::vec4 &color) const;
-    void set_outline_factor(float factor) const;
+    // draw everything submitted since the last flush
+    void flush(FontShader &font_shader, const FontAtlas &font);
 };
@@ -0,0 +1,231 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+#include "log.hpp"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
+namespace {
+bool set_swap_interval(const FramePacer &pacer, int interval) {
+#ifdef __EMSCRIPTEN__
+    return SDL_SetRenderVSync(pacer.renderer, interval);
+#else
+    (void)pacer;
+    return SDL_GL_SetSwapInterval(interval);
+#endif
+}
+
+#ifndef __EMSCRIPTEN__
+void delay_precise(uint64_t ns) {
+#if SDL_VERSION_ATLEAST(3, 2, 0)
+    SDL_DelayPrecise(ns);
+#else
+    SDL_DelayNS(ns);
+#endif
+}
+#endif
+}  // namespace
+
+const char *pacing_mode_name(PacingMode mode) {
+    switch (mode) {
+        case PacingMode::VSYNC:
+            return "vsync";
+        case PacingMode::ADAPTIVE_VSYNC:
+            return "adaptive_vsync";
+        case PacingMode::LIMITER:
+            return "limiter";
+    }
+
+    return "";
+}
+
+bool FramePacer::init(SDL_Window *window_, SDL_Renderer *renderer_, PacingMode mode_) {
+    window = window_;
+    renderer = renderer_;
+
+    if (const SDL_DisplayMode *display = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window))) {
+        if (display->refresh_rate > 0) {
+            refresh_hz = display->refresh_rate;
+        }
+    }
+
+    limit_hz = refresh_hz;
+
+    return set_mode(mode_);
+}
+
+bool FramePacer::set_mode(PacingMode new_mode) {
+    mode = new_mode;
+    deadline_ns = 0;
+    main_loop_limit_hz = -1.0f;  // SDL_SetRenderVSync sets the main loop timing too
+
+    bool ok = true;
+
+    switch (mode) {
+        case PacingMode::VSYNC:
+            ok = set_swap_interval(*this, 1);
+            break;
+        case PacingMode::ADAPTIVE_VSYNC:
+            ok = set_swap_interval(*this, -1);
+            break;
+        case PacingMode::LIMITER:
+            ok = set_swap_interval(*this, 0);
+            break;
+    }
+
+    if (!ok) {
+        LOG("can't set %s: %s, using the limiter at %.0f Hz",
+            pacing_mode_name(mode),
+            SDL_GetError(),
+            static_cast<double>(refresh_hz));
+
+        mode = PacingMode::LIMITER;
+        limit_hz = refresh_hz;
+        set_swap_interval(*this, 0);
+    } else {
+        LOG("frame pacing: %s", pacing_mode_name(mode));
+    }
+
+    // stats from the old mode don't mean anything for the new one
+    num_interval = 0;
+    next_interval = 0;
+    frames = 0;
+    missed = 0;
+    last_present_ns = 0;
+
+    return ok;
+}
+
+void FramePacer::next_mode() {
+    switch (mode) {
+        case PacingMode::VSYNC:
+            set_mode(PacingMode::ADAPTIVE_VSYNC);
+            break;
+        case PacingMode::ADAPTIVE_VSYNC:
+            set_mode(PacingMode::LIMITER);
+            break;
+        case PacingMode::LIMITER:
+            set_mode(PacingMode::VSYNC);
+            break;
+    }
+}
+
+void FramePacer::wait() {
+    if (mode != PacingMode::LIMITER || limit_hz <= 0) {
+        return;
+    }
+
+#ifdef __EMSCRIPTEN__
+    // Blocking here would stall the browser, so its main loop timer does the limiting instead of the sleep and spin.
+    // It's set from here because SDL only starts the main loop after SDL_AppInit.
+    if (main_loop_limit_hz != limit_hz) {
+        emscripten_set_main_loop_timing(EM_TIMING_SETTIMEOUT, static_cast<int>(std::lround(1000.0f / limit_hz)));
+        main_loop_limit_hz = limit_hz;
+    }
+#else
+    uint64_t period_ns = static_cast<uint64_t>(1e9f / limit_hz);
+    uint64_t now = SDL_GetTicksNS();
+
+    // first frame, or fell more than a frame behind, start over from now rather than rushing to catch up
+    if (deadline_ns == 0 || now > deadline_ns + period_ns) {
+        deadline_ns = now + period_ns;
+        return;
+    }
+
+    if (deadline_ns > now + PACER_SPIN_NS) {
+        delay_precise(deadline_ns - now - PACER_SPIN_NS);
+    }
+
+    while (SDL_GetTicksNS() < deadline_ns) {
+    }
+
+    deadline_ns += period_ns;
+#endif
+}
+
+void FramePacer::presented(uint64_t now_ns, bool record) {
+    if (record && last_present_ns > 0) {
+        float ms = static_cast<float>(now_ns - last_present_ns) * 1e-6f;
+        float period = target_period_ms();
+
+        interval_ms[next_interval] = ms;
+        next_interval = (next_interval + 1) % interval_ms.size();
+        num_interval = std::min(num_interval + 1, interval_ms.size());
+        frames++;
+
+        if (period > 0 && ms > period * PACER_MISSED_FACTOR) {
+            missed++;
+        }
+    }
+
+    // throttled frames break the chain, the next interval would count the throttling
+    last_present_ns = record ? now_ns : 0;
+}
+
+float FramePacer::target_period_ms() const {
+    float hz = mode == PacingMode::LIMITER ? limit_hz : refresh_hz;
+
+    return hz > 0 ? 1000.0f / hz : 0.0f;
+}
+
+float FramePacer::mean_ms() const {
+    if (num_interval == 0) {
+        return 0.0f;
+    }
+
+    float sum = 0;
+
+    for (size_t i = 0; i < num_interval; i++) {
+        sum += interval_ms[i];
+    }
+
+    return sum / static_cast<float>(num_interval);
+}
+
+float FramePacer::stddev_ms() const {
+    if (num_interval < 2) {
+        return 0.0f;
+    }
+
+    float mean = mean_ms();
+    float sum = 0;
+
+    for (size_t i = 0; i < num_interval; i++) {
+        float d = interval_ms[i] - mean;
+        sum += d * d;
+    }
+
+    return std::sqrt(sum / static_cast<float>(num_interval - 1));
+}
+
+std::string FramePacer::json() const {
+    float period = target_period_ms();
+    std::ostringstream ss;
+
+    ss << "{\"mode\": \"" << pacing_mode_name(mode) << "\", \"target_hz\": " << (period > 0 ? 1000.0f / period : 0.0f)
+       << ", \"frames\": " << frames << ", \"mean_ms\": " << mean_ms() << ", \"stddev_ms\": " << stddev_ms()
+       << ", \"missed\": " << missed << "}";
+
+    return ss.str();
+}
+
+std::string FramePacer::text() const {
+    char buf[128];
+
+    snprintf(buf,
+             sizeof(buf),
+             "frame pacing: %s, %.2f ms +- %.2f, %d missed of %d",
+             pacing_mode_name(mode),
+             static_cast<double>(mean_ms()),
+             static_cast<double>(stddev_ms()),
+             static_cast<int>(missed),
+             static_cast<int>(frames));
+
+    return buf;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class PacingMode {
+    VSYNC,           // swap interval 1
+    ADAPTIVE_VSYNC,  // swap interval -1, late frames tear instead of waiting a whole refresh
+    LIMITER,         // swap interval 0, sleep to limit_hz, emscripten sets the browser main loop timer instead
+};
+
+constexpr uint64_t PACER_SPIN_NS = 1'000'000;  // the last part of the limiter wait is a spin, sleeps overshoot
+constexpr float PACER_MISSED_FACTOR = 1.5f;    // a frame interval this many periods long missed its deadline
+constexpr size_t PACER_HISTORY = 240;          // frame intervals kept for the jitter stats
+
+const char *pacing_mode_name(PacingMode mode);
+
+// Controls when frames are presented and measures how evenly they are.
+// Falls back to the limiter when vsync can't be set, e.g. some VMs and kiosk displays.
+struct FramePacer {
+    SDL_Window *window = nullptr;
+    SDL_Renderer *renderer = nullptr;  // emscripten sets vsync through the renderer, it owns the GL context there
+
+    PacingMode mode = PacingMode::VSYNC;
+    float refresh_hz = 60.0f;  // of the display the window is on
+    float limit_hz = 60.0f;    // LIMITER only, 0 is uncapped
+
+    uint64_t deadline_ns = 0;          // LIMITER, when the next frame is due
+    float main_loop_limit_hz = -1.0f;  // emscripten LIMITER, what the browser main loop timer was last set to
+
+    // frame intervals, ring buffer
+    std::array<float, PACER_HISTORY> interval_ms{};
+    size_t num_interval = 0;
+    size_t next_interval = 0;
+    uint64_t frames = 0;  // total recorded, not just what's in interval_ms
+    uint64_t missed = 0;
+    uint64_t last_present_ns = 0;
+
+    bool init(SDL_Window *window_, SDL_Renderer *renderer_, PacingMode mode_);
+
+    // Returns false if the mode couldn't be set, mode is then LIMITER at the refresh rate
+    bool set_mode(PacingMode new_mode);
+    void next_mode();  // cycles through all of them
+
+    void wait();                                   // call just before SDL_GL_SwapWindow
+    void presented(uint64_t now_ns, bool record);  // call just after, record is false for throttled frames
+
+    float target_period_ms() const;  // 0 when uncapped
+    float mean_ms() const;
+    float stddev_ms() const;
+
+    // {"mode": ..., "target_hz": ..., "frames": ..., "mean_ms": ..., "stddev_ms": ..., "missed": ...}
+    std::string json() const;
+    std::string text() const;  // one line summary
+};
@@ -0,0 +1,104 @@
+#include "frame_scheduler.hpp"
+
+#include <string>
+
+#include "log.hpp"
+
+bool is_input_event(const SDL_Event &event) {
+    switch (event.type) {
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+        case SDL_EVENT_MOUSE_BUTTON_UP:
+        case SDL_EVENT_MOUSE_MOTION:
+        case SDL_EVENT_FINGER_DOWN:
+        case SDL_EVENT_FINGER_UP:
+        case SDL_EVENT_FINGER_MOTION:
+            return true;
+    }
+
+    return false;
+}
+
+void FrameScheduler::handle_event(const SDL_Event &event) {
+    switch (event.type) {
+        case SDL_EVENT_WINDOW_HIDDEN:
+        case SDL_EVENT_WINDOW_MINIMIZED:
+            hidden = true;
+            break;
+
+        case SDL_EVENT_WINDOW_SHOWN:
+        case SDL_EVENT_WINDOW_RESTORED:
+            hidden = false;
+            break;
+
+        case SDL_EVENT_WINDOW_OCCLUDED:
+            occluded = true;
+            break;
+
+        case SDL_EVENT_WINDOW_EXPOSED:
+            occluded = false;
+            break;
+
+        case SDL_EVENT_WILL_ENTER_BACKGROUND:
+            background = true;
+            break;
+
+        case SDL_EVENT_DID_ENTER_FOREGROUND:
+            background = false;
+            break;
+    }
+
+    if (is_input_event(event)) {
+        last_input_ns = event.common.timestamp;
+
+        if (rate == FrameRate::IDLE) {
+            set_rate(FrameRate::FULL);
+        }
+    }
+
+    // straight away rather than in update, it won't be called while paused with "waitevent"
+    if (rate == FrameRate::PAUSED && !hidden && !occluded && !background) {
+        set_rate(FrameRate::FULL);
+    }
+}
+
+bool FrameScheduler::update(uint64_t now_ns, bool busy) {
+    FrameRate new_rate = FrameRate::FULL;
+
+    if (enabled && (hidden || occluded || background)) {
+        new_rate = FrameRate::PAUSED;
+    } else if (enabled && !busy && now_ns - last_input_ns > IDLE_DELAY_NS) {
+        new_rate = FrameRate::IDLE;
+    }
+
+    if (new_rate != rate) {
+        set_rate(new_rate);
+    }
+
+    return rate != FrameRate::PAUSED;
+}
+
+void FrameScheduler::set_rate(FrameRate new_rate) {
+    bool pause_changed = (rate == FrameRate::PAUSED) != (new_rate == FrameRate::PAUSED);
+    rate = new_rate;
+
+    // "0" runs as fast as vsync allows
+    std::string hint = "0";
+
+    if (rate == FrameRate::IDLE) {
+        hint = std::to_string(IDLE_FRAME_RATE);
+    } else if (rate == FrameRate::PAUSED) {
+#if SDL_VERSION_ATLEAST(3, 2, 0)
+        hint = "waitevent";
+#else
+        hint = std::to_string(1'000'000'000 / PAUSED_POLL_NS);
+#endif
+    }
+
+    SDL_SetHint(SDL_HINT_MAIN_CALLBACK_RATE, hint.c_str());
+
+    // idle <-> full happens on every pause in input, too often to log
+    if (pause_changed) {
+        LOG("frame rate %s", hint.c_str());
+    }
+}
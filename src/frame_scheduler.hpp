@@ -0,0 +1,41 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include <cstdint>
+
+// How often SDL_AppIterate runs, set through SDL_HINT_MAIN_CALLBACK_RATE.
+enum class FrameRate {
+    FULL,    // as fast as vsync allows
+    IDLE,    // IDLE_FRAME_RATE, only the idle rotation is moving
+    PAUSED,  // nothing is visible, SDL_AppIterate should skip the frame
+};
+
+constexpr int IDLE_FRAME_RATE = 20;                // Hz
+constexpr uint64_t IDLE_DELAY_NS = 3'000'000'000;  // full rate for this long after the last input
+constexpr uint64_t PAUSED_POLL_NS = 250'000'000;   // older SDL without "waitevent" wakes up this often
+
+// Key, mouse and touch events
+bool is_input_event(const SDL_Event &event);
+
+// Drops the frame rate when nothing much is happening and stops rendering while the window can't be seen.
+// Audio keeps going on its own, see Audio::loop.
+struct FrameScheduler {
+    bool enabled = true;  // off gives full rate all the time, e.g. for the benchmark
+
+    bool hidden = false;      // hidden or minimized
+    bool occluded = false;    // covered by other windows
+    bool background = false;  // mobile app in the background
+
+    uint64_t last_input_ns = 0;
+    FrameRate rate = FrameRate::FULL;
+
+    // Input snaps straight back to full rate, window and app events pause and resume
+    void handle_event(const SDL_Event &event);
+
+    // Call at the start of SDL_AppIterate. busy is true while more than the idle rotation is changing, e.g. a shape
+    // is being dragged. Returns false if the frame should be skipped.
+    bool update(uint64_t now_ns, bool busy);
+
+    void set_rate(FrameRate new_rate);
+};
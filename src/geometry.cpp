@@ -3,218 +3,614 @@
 #include <GLES2/gl2.h>
 
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <random>
 
 #include "gl_helper.hpp"
+#include "log.hpp"
+#include "mesh_optimize.hpp"
+#include "shape_table.hpp"
+#include "view.hpp"
 
 namespace {
-const char *vertex_shader = R"(#version 300 es
-precision mediump float;
-
+const char *vertex_shader =
+    "#version 300 es\nprecision mediump float;\n" VIEW_UNIFORM_GLSL SHAPE_UNIFORM_GLSL R"(
 layout(location = 0) in vec2 pos; // normalized by drawinga area width
+layout(location = 1) in vec2 extrude; // screen pixels, moves the vertex for the antialiasing fringe
+layout(location = 2) in float coverage;
+
+out float frag_coverage;
+
+void main() {
+    highp float theta = theta0 + omega*(time - start_time);
+    float c = cos(theta);
+    float s = sin(theta);
+    mat2 rotation = mat2(c, s, -s, c);
+
+    // one screen pixel in shape units
+    float px = 1.0 / (scale * display_width);
+
+    vec2 p = (pos + extrude*px) * position_scale;
+
+    gl_Position = ortho_matrix * vec4(rotation*p*scale + trans, 0.0, 1.0);
+    frag_coverage = coverage;
+})";
+
+const char *fragment_shader = "#version 300 es\nprecision mediump float;\n" SHAPE_UNIFORM_GLSL R"(
+in float frag_coverage;
+out vec4 frag_color;
+
+void main() {
+    frag_color = vec4(color.rgb, color.a * frag_coverage);
+})";
 
-uniform vec2 drawing_area_offset; // screen pixel units
-uniform float scale; // scale to apply on normalized units
-uniform float theta; // rotation in radians
-uniform vec2 trans; // normalized units
-uniform mat4 ortho_matrix;
+// Same as vertex_shader, with the ShapeInstance data picked per vertex from the outline batch
+const char *line_batch_vertex_shader =
+    "#version 300 es\nprecision mediump float;\n" VIEW_UNIFORM_GLSL SHAPE_LINE_BATCH_GLSL R"(
+layout(location = 0) in vec2 pos;
+layout(location = 1) in vec2 extrude;
+layout(location = 2) in float coverage;
+layout(location = 3) in float slot; // index into shape[], the same for every vertex of an outline
+
+out float frag_coverage;
+flat out vec4 frag_color;
 
 void main() {
+    ShapeData d = shape[int(slot)];
+
+    highp float theta = d.theta0 + d.omega*(time - d.start_time);
     float c = cos(theta);
     float s = sin(theta);
     mat2 rotation = mat2(c, s, -s, c);
 
-    gl_Position = ortho_matrix * vec4(rotation*pos*scale + trans, 0.0, 1.0);
+    float px = 1.0 / (d.scale * display_width);
+
+    vec2 p = (pos + extrude*px) * d.position_scale;
+
+    gl_Position = ortho_matrix * vec4(rotation*p*d.scale + d.trans, 0.0, 1.0);
+    frag_coverage = coverage;
+    frag_color = d.color;
 })";
 
-const char *fragment_shader = R"(#version 300 es
+const char *line_batch_fragment_shader = R"(#version 300 es
 precision mediump float;
 
-uniform vec4 color;
+in float frag_coverage;
+flat in vec4 frag_color;
+out vec4 color;
+
+void main() {
+    color = vec4(frag_color.rgb, frag_color.a * frag_coverage);
+})";
+
+const char *sdf_vertex_shader = "#version 300 es\nprecision highp float;\n" VIEW_UNIFORM_GLSL R"(
+layout(location = 0) in vec2 pos; // corner of a [-1, 1] quad
+
+uniform float extent; // half size of the quad in shape units
+uniform float scale;
+uniform float theta0; // see ShapeRotation
+uniform float omega;
+uniform float start_time;
+uniform vec2 trans;
+out vec2 shape_pos; // shape units, before rotation
+
+void main() {
+    float theta = theta0 + omega*(time - start_time);
+    float c = cos(theta);
+    float s = sin(theta);
+    mat2 rotation = mat2(c, s, -s, c);
+
+    shape_pos = pos * extent;
+    gl_Position = ortho_matrix * vec4(rotation*shape_pos*scale + trans, 0.0, 1.0);
+})";
+
+const char *sdf_fragment_shader = R"(#version 300 es
+precision highp float;
+
+uniform int sides; // 0 for ellipse
+uniform vec2 radius;
+uniform vec4 fill_color;
+uniform vec4 line_color;
+uniform float line_width; // shape units, 0 for no line
+
+in vec2 shape_pos;
 out vec4 frag_color;
 
+const float PI = 3.14159265;
+
+float sd_ellipse(vec2 p, vec2 r) {
+    // approximation, exact for a circle
+    float k0 = length(p / r);
+    float k1 = length(p / (r * r));
+    return k0 * (k0 - 1.0) / max(k1, 1e-6);
+}
+
+// vertex i at angle i*2pi/n with radius r[i % 2]
+float sd_polygon(vec2 p, int n, vec2 r) {
+    float sector = 2.0 * PI / float(n);
+
+    // the shape repeats every 2 sectors and is mirrored about each vertex,
+    // so fold p into the sector between vertex 0 and 1
+    float a = mod(atan(p.y, p.x), 2.0 * sector);
+    if (a > sector) {
+        a = 2.0 * sector - a;
+    }
+
+    vec2 q = length(p) * vec2(cos(a), sin(a));
+    vec2 v0 = vec2(r.x, 0.0);
+    vec2 v1 = r.y * vec2(cos(sector), sin(sector));
+
+    vec2 e = v1 - v0;
+    vec2 w = q - v0;
+    float h = clamp(dot(w, e) / dot(e, e), 0.0, 1.0);
+    float d = length(w - e * h);
+
+    // the centre is on the left of v0 -> v1
+    return (e.x * w.y - e.y * w.x) > 0.0 ? -d : d;
+}
+
+// 1 inside (d < 0), 0 outside, smooth over 1 pixel
+float coverage(float d, float aa) {
+    return clamp(0.5 - d / aa, 0.0, 1.0);
+}
+
 void main() {
-    frag_color = color;
+    float d = sides == 0 ? sd_ellipse(shape_pos, radius) : sd_polygon(shape_pos, sides, radius);
+    float aa = fwidth(d);
+
+    float fill_a = fill_color.a * coverage(d, aa);
+    float line_a = line_width > 0.0 ? line_color.a * coverage(abs(d) - line_width * 0.5, aa) : 0.0;
+
+    // line over fill
+    float a = line_a + fill_a * (1.0 - line_a);
+    vec3 rgb = line_color.rgb * line_a + fill_color.rgb * fill_a * (1.0 - line_a);
+
+    frag_color = vec4(rgb / max(a, 1e-6), a);
 })";
 
+// Signed area sign of the polygon, decides which side of an edge is outside
+float winding(std::span<const glm::vec2> vert) {
+    size_t n = vert.size();
+
+    float area = 0;
+    for (size_t i = 0; i < n; i++) {
+        const glm::vec2 &a = vert[i];
+        const glm::vec2 &b = vert[(i + 1) % n];
+        area += a.x * b.y - a.y * b.x;
+    }
+
+    return area >= 0 ? 1.f : -1.f;
+}
+
+// Normal pointing out of the polygon at each vertex, scaled so that moving 1 unit along it
+// moves both adjacent edges out by 1 unit (miter join).
+void miter_normal(std::span<const glm::vec2> vert, std::span<glm::vec2> out) {
+    size_t n = vert.size();
+    float sign = winding(vert);
+
+    for (size_t i = 0; i < n; i++) {
+        glm::vec2 e0 = glm::normalize(vert[i] - vert[(i + n - 1) % n]);
+        glm::vec2 e1 = glm::normalize(vert[(i + 1) % n] - vert[i]);
+
+        glm::vec2 n0 = glm::vec2{e0.y, -e0.x} * sign;
+        glm::vec2 n1 = glm::vec2{e1.y, -e1.x} * sign;
+
+        glm::vec2 m = glm::normalize(n0 + n1);
+        out[i] = m / std::max(glm::dot(m, n1), 0.25f);  // limit the miter length on sharp corners
+    }
+}
+
+constexpr float LOD_MAX_CHORD_ERROR_PX = 0.5f;
+
+// accumulated over every mesh made, reported by make_shape_set
+MeshOptimizeStats mesh_optimize_stats;
+
+constexpr VertexAttrib SHORT_VERTEX_LAYOUT[] = {
+    {0, 2, GL_SHORT, GL_TRUE, offsetof(ShortShapeVertex, pos)},
+    {1, 2, GL_SHORT, GL_TRUE, offsetof(ShortShapeVertex, extrude)},
+    {2, 1, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(ShortShapeVertex, coverage)},
+};
+
+constexpr VertexAttrib SHAPE_VERTEX_LAYOUT[] = {
+    {0, 2, GL_FLOAT, GL_FALSE, offsetof(ShapeVertex, pos)},
+    {1, 2, GL_FLOAT, GL_FALSE, offsetof(ShapeVertex, extrude)},
+    {2, 1, GL_FLOAT, GL_FALSE, offsetof(ShapeVertex, coverage)},
+};
+
+void set_short_vertex_layout(VertexBuffer &v, GLenum mode) {
+    v.stride = sizeof(ShortShapeVertex);
+    v.position_scale = SHORT_VERTEX_RANGE;
+    v.mode = mode;
+    v.layout = SHORT_VERTEX_LAYOUT;
+}
+
+// Indices of a line mesh for the outline batch, the table stores restart as 0xffff
+template <typename INDEX>
+std::span<const uint32_t> copy_line_index(Arena &storage, std::span<const INDEX> index) {
+    std::span<uint32_t> ret = storage.alloc<uint32_t>(index.size());
+
+    for (size_t i = 0; i < index.size(); i++) {
+        bool restart = index[i] == static_cast<INDEX>(PRIMITIVE_RESTART_INDEX);
+        ret[i] = restart ? PRIMITIVE_RESTART_INDEX : index[i];
+    }
+
+    return ret;
+}
+
+// Copy of data that lives as long as storage
+template <typename T>
+std::span<const T> store_copy(Arena &storage, std::span<const T> data) {
+    std::span<T> ret = storage.alloc<T>(data.size());
+    std::copy(data.begin(), data.end(), ret.begin());
+
+    return ret;
+}
+
+// line_copy is only given for line meshes, the table vertices are used in place
+VertexBufferPtr make_shape_vertex_buffer(Arena &storage, const StaticMesh &mesh, ShapeLineCopy *line_copy = nullptr) {
+    VertexBufferPtr v = make_vertex_buffer(storage, mesh.vertex.data(), mesh.vertex.size_bytes(), mesh.index);
+    set_short_vertex_layout(*v, mesh.mode);
+
+    if (line_copy) {
+        line_copy->vertex = std::as_bytes(mesh.vertex);
+        line_copy->index = copy_line_index(storage, mesh.index);
+    }
+
+    return v;
+}
+
+VertexBufferPtr make_shape_vertex_buffer(
+    Arena &arena, Arena &storage, VertexIndex vi, bool short_vertex, ShapeLineCopy *line_copy = nullptr) {
+    mesh_optimize_stats += optimize_mesh(arena, vi);
+
+    std::span<const std::byte> vertex = std::as_bytes(vi.vertex);
+    std::span<const VertexAttrib> layout = SHAPE_VERTEX_LAYOUT;
+    auto stride = static_cast<GLsizei>(sizeof(ShapeVertex));
+    float position_scale = 1.0f;
+
+    if (short_vertex) {
+        std::span<ShortShapeVertex> packed = arena.alloc<ShortShapeVertex>(vi.vertex.size());
+
+        for (size_t i = 0; i < vi.vertex.size(); i++) {
+            const ShapeVertex &sv = vi.vertex[i];
+
+            packed[i] = {{quantize_snorm(sv.pos.x), quantize_snorm(sv.pos.y)},
+                         {quantize_snorm(sv.extrude.x), quantize_snorm(sv.extrude.y)},
+                         quantize_unorm(sv.coverage),
+                         {}};
+        }
+
+        vertex = std::as_bytes(packed);
+        layout = SHORT_VERTEX_LAYOUT;
+        stride = sizeof(ShortShapeVertex);
+        position_scale = SHORT_VERTEX_RANGE;
+    }
+
+    VertexBufferPtr v = make_vertex_buffer(arena, storage, vertex.data(), vertex.size(), vi.index);
+    v->stride = stride;
+    v->position_scale = position_scale;
+    v->mode = vi.mode;
+    v->layout = layout;
+
+    if (line_copy) {
+        line_copy->vertex = store_copy(storage, vertex);
+        line_copy->index = copy_line_index<uint32_t>(storage, vi.index);
+    }
+
+    return v;
+}
+
+// Fill, line and highlight line meshes for an outline, the scratch memory is released on return.
+// The lines are also copied to storage for the outline batch when line_copy is set.
+void make_shape_mesh(Arena &arena,
+                     Arena &storage,
+                     std::span<const glm::vec2> vert,
+                     float line_thickness,
+                     const ShapeMeshFormat &format,
+                     bool line_copy,
+                     ShapeLod &mesh) {
+    bool feather = format.feather;
+
+    {
+        ArenaScope scope(arena);
+        mesh.fill = make_shape_vertex_buffer(arena, storage, make_fill(arena, vert, feather), format.short_vertex);
+    }
+
+    {
+        ArenaScope scope(arena);
+        VertexIndex vi = make_line(arena, vert, line_thickness, feather, format.line_join);
+        mesh.line =
+            make_shape_vertex_buffer(arena, storage, vi, format.short_vertex, line_copy ? &mesh.line_copy : nullptr);
+    }
+
+    {
+        ArenaScope scope(arena);
+        VertexIndex vi = make_line(arena, vert, line_thickness * 2, feather, format.line_join);
+        mesh.line_highlight = make_shape_vertex_buffer(
+            arena, storage, vi, format.short_vertex, line_copy ? &mesh.line_highlight_copy : nullptr);
+    }
+}
+
 }  // namespace
    // :
-std::vector<glm::vec2> make_polygon(int sides, const std::vector<float> &radius) {
-    std::vector<glm::vec2> vert;
+std::span<glm::vec2> make_polygon(Arena &arena, int sides, std::initializer_list<float> radius) {
+    std::span<glm::vec2> vert = arena.alloc<glm::vec2>(static_cast<size_t>(sides));
 
     for (int i = 0; i < sides; i++) {
         float theta = static_cast<float>(i * 2 * M_PI / sides);
-        float r = radius[static_cast<size_t>(i) % radius.size()];
+        float r = radius.begin()[static_cast<size_t>(i) % radius.size()];
         float x = r * std::cos(theta);
         float y = r * std::sin(theta);
 
-        vert.push_back(glm::vec2{x, y});
+        vert[static_cast<size_t>(i)] = glm::vec2{x, y};
     }
 
     return vert;
 }
 
-VertexIndex make_fill(const std::vector<glm::vec2> &vert) {
-    std::vector<glm::vec2> fill_vert;
-    std::vector<uint32_t> fill_idx;
+VertexIndex make_fill(Arena &arena, std::span<const glm::vec2> vert, bool feather) {
+    size_t n = vert.size();
 
-    fill_vert = vert;
-    fill_vert.push_back(glm::vec2{0.0f, 0.0f});  // cener of shape
+    // center + n, and n more for the fringe
+    std::span<ShapeVertex> fill_vert = arena.alloc<ShapeVertex>(feather ? n * 2 + 1 : n + 1);
+    std::span<uint32_t> fill_idx = arena.alloc<uint32_t>(feather ? n * 9 : n * 3);
+    std::span<glm::vec2> normal = arena.alloc<glm::vec2>(n);
 
-    for (size_t i = 0; i < vert.size(); i++) {
-        uint32_t j = static_cast<uint32_t>((i + 1) % vert.size());
+    if (feather) {
+        miter_normal(vert, normal);
+    } else {
+        std::fill(normal.begin(), normal.end(), glm::vec2{0.f});
+    }
 
-        fill_idx.push_back(static_cast<uint32_t>(i));
-        fill_idx.push_back(j);
-        fill_idx.push_back(static_cast<uint32_t>(fill_vert.size() - 1));
+    // the fringe is centred on the edge, half a pixel in and half out
+    for (size_t i = 0; i < n; i++) {
+        fill_vert[i] = {vert[i], -normal[i] * 0.5f, 1.f};
     }
 
+    fill_vert[n] = {glm::vec2{0.0f, 0.0f}};  // cener of shape
+
+    uint32_t *idx = fill_idx.data();
+
+    for (size_t i = 0; i < n; i++) {
+        uint32_t j = static_cast<uint32_t>((i + 1) % n);
+
+        *idx++ = static_cast<uint32_t>(i);
+        *idx++ = j;
+        *idx++ = static_cast<uint32_t>(n);
+    }
+
+    if (feather) {
+        uint32_t outer = static_cast<uint32_t>(n + 1);
+
+        for (size_t i = 0; i < n; i++) {
+            fill_vert[outer + i] = {vert[i], normal[i] * 0.5f, 0.f};
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t j = static_cast<uint32_t>((i + 1) % n);
+
+            for (uint32_t k : {i, j, outer + j, i, outer + j, outer + i}) {
+                *idx++ = k;
+            }
+        }
+    }
+
+    assert(idx == fill_idx.data() + fill_idx.size());
+
     return {fill_vert, fill_idx};
 }
 
-VertexIndex make_line(const std::vector<glm::vec2> &vert, float thickness) {
-    // quads for each line
-    std::vector<glm::vec2> tri_pts;
-    std::vector<uint32_t> tri_idx;
-    std::vector<glm::vec2> inner, outer;
+namespace {
+// Outer and inner offset direction of the line at one point along the outline.
+// A miter join has one sample per polygon vertex, bevel and round joins add more on the outside of the turn.
+struct LineSample {
+    glm::vec2 vert;
+    glm::vec2 outer;  // scaled so the line edge is thickness/2 away from both adjacent edges
+    glm::vec2 inner;
+};
+
+// Miters longer than this (in multiples of thickness/2) turn into bevels, same as the SVG default
+constexpr float MITER_LIMIT = 4.0f;
+
+// Radians of arc per segment of a round join
+constexpr float ROUND_JOIN_STEP = static_cast<float>(M_PI) / 8;
+
+// Corner of the outline at vert[i]
+struct LineCorner {
+    glm::vec2 n0, n1;  // outward normal of the edge before and after
+    glm::vec2 miter;
+    bool convex;
+    int samples;  // LineSample count for the join
+};
+
+LineCorner line_corner(std::span<const glm::vec2> vert, size_t i, float sign, LineJoin join) {
+    size_t n = vert.size();
+
+    glm::vec2 e0 = glm::normalize(vert[i] - vert[(i + n - 1) % n]);
+    glm::vec2 e1 = glm::normalize(vert[(i + 1) % n] - vert[i]);
+
+    LineCorner c;
+    c.n0 = glm::vec2{e0.y, -e0.x} * sign;
+    c.n1 = glm::vec2{e1.y, -e1.x} * sign;
+
+    glm::vec2 m = glm::normalize(c.n0 + c.n1);
+    float cos_half = glm::dot(m, c.n1);
+
+    c.miter = m / std::max(cos_half, 1.f / MITER_LIMIT);
+    c.convex = (e0.x * e1.y - e0.y * e1.x) * sign > 0;
+
+    if (join == LineJoin::MITER && cos_half >= 1.f / MITER_LIMIT) {
+        c.samples = 1;
+    } else if (join == LineJoin::ROUND) {
+        float angle = std::acos(std::clamp(glm::dot(c.n0, c.n1), -1.f, 1.f));
+        c.samples = std::max(static_cast<int>(std::ceil(angle / ROUND_JOIN_STEP)), 1) + 1;
+    } else {
+        c.samples = 2;  // bevel
+    }
+
+    return c;
+}
 
-    for (size_t i = 0; i < vert.size(); i++) {
-        size_t j = (i + 1) % vert.size();
+std::span<LineSample> make_line_sample(Arena &arena, std::span<const glm::vec2> vert, LineJoin join) {
+    size_t n = vert.size();
+    float sign = winding(vert);
 
-        glm::vec2 v = vert[j] - vert[i];
-        v /= glm::length(v);
+    // two passes, the first one only counts so the output is allocated once
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        count += static_cast<size_t>(line_corner(vert, i, sign, join).samples);
+    }
 
-        // normal to the line
-        glm::vec2 n{-v[1], v[0]};
+    std::span<LineSample> ret = arena.alloc<LineSample>(count);
+    LineSample *out = ret.data();
 
-        uint32_t idx = static_cast<uint32_t>(tri_pts.size());
+    for (size_t i = 0; i < n; i++) {
+        LineCorner c = line_corner(vert, i, sign, join);
 
-        tri_idx.push_back(idx + 0);
-        tri_idx.push_back(idx + 1);
-        tri_idx.push_back(idx + 2);
-        tri_idx.push_back(idx + 0);
-        tri_idx.push_back(idx + 2);
-        tri_idx.push_back(idx + 3);
+        if (c.samples == 1) {
+            *out++ = {vert[i], c.miter, c.miter};
+            continue;
+        }
 
-        tri_pts.push_back(vert[i] + n * thickness * 0.5f);
-        tri_pts.push_back(vert[j] + n * thickness * 0.5f);
-        tri_pts.push_back(vert[j] - n * thickness * 0.5f);
-        tri_pts.push_back(vert[i] - n * thickness * 0.5f);
+        // the side on the inside of the turn always meets at the miter point
+        for (int k = 0; k < c.samples; k++) {
+            float t = static_cast<float>(k) / static_cast<float>(c.samples - 1);
+            glm::vec2 a = glm::normalize(glm::mix(c.n0, c.n1, t));
 
-        outer.push_back(vert[i] + n * thickness * 0.5f);
-        outer.push_back(vert[j] + n * thickness * 0.5f);
-        inner.push_back(vert[j] - n * thickness * 0.5f);
-        inner.push_back(vert[i] - n * thickness * 0.5f);
+            if (c.convex) {
+                *out++ = {vert[i], a, c.miter};
+            } else {
+                *out++ = {vert[i], c.miter, a};
+            }
+        }
     }
 
-    // miter
-    for (size_t i = 0; i < vert.size(); i++) {
-        size_t j = (i + 1) % vert.size();
+    return ret;
+}
+}  // namespace
 
-        for (const auto &pts : {inner, outer}) {
-            glm::vec2 p0 = pts[i * 2];
-            glm::vec2 p1 = pts[i * 2 + 1];
-            glm::vec2 p2 = pts[j * 2];
-            glm::vec2 p3 = pts[j * 2 + 1];
+VertexIndex make_line(Arena &arena, std::span<const glm::vec2> vert, float thickness, bool feather, LineJoin join) {
+    std::span<LineSample> sample = make_line_sample(arena, vert, join);
 
-            glm::vec2 v0 = p1 - p0;
-            glm::vec2 v1 = p3 - p2;
+    // Rings of vertices around the outline, each pair of neighbouring rings is joined by a closed triangle strip.
+    // With feather: outer fringe, outer edge, inner edge, inner fringe.
+    uint32_t rings = feather ? 4 : 2;
+    uint32_t count = static_cast<uint32_t>(sample.size());
+    float half = thickness * 0.5f;
 
-            // find intersection of 2 lines
-            // Ax = b
-            // A = [v0 | -v1]
-            // b = p2 - p0
-            // use Cramer's rule
+    std::span<ShapeVertex> line_vert = arena.alloc<ShapeVertex>(count * rings);
+    std::span<uint32_t> line_idx = arena.alloc<uint32_t>((rings - 1) * (count + 1) * 2 + (rings - 2));
 
-            glm::vec2 b = p2 - p0;
+    ShapeVertex *v = line_vert.data();
 
-            double det = v0[0] * (-v1[1]) - (-v1[0] * v0[1]);
-            double c0 = b[0] * (-v1[1]) - (-v1[0] * b[1]);
-            float t0 = static_cast<float>(c0 / det);
+    for (const auto &p : sample) {
+        glm::vec2 outer = p.vert + p.outer * half;
+        glm::vec2 inner = p.vert - p.inner * half;
 
-            glm::vec2 pp = p0 + v0 * t0;
+        if (feather) {
+            *v++ = {outer, p.outer * 0.5f, 0.f};
+            *v++ = {outer, -p.outer * 0.5f, 1.f};
+            *v++ = {inner, p.inner * 0.5f, 1.f};
+            *v++ = {inner, -p.inner * 0.5f, 0.f};
+        } else {
+            *v++ = {outer};
+            *v++ = {inner};
+        }
+    }
 
-            uint32_t idx = static_cast<uint32_t>(tri_pts.size());
+    uint32_t *idx = line_idx.data();
 
-            tri_idx.push_back(idx + 0);
-            tri_idx.push_back(idx + 1);
-            tri_idx.push_back(idx + 2);
-            tri_idx.push_back(idx + 0);
-            tri_idx.push_back(idx + 1);
-            tri_idx.push_back(idx + 3);
+    for (uint32_t r = 0; r + 1 < rings; r++) {
+        if (r > 0) {
+            *idx++ = PRIMITIVE_RESTART_INDEX;
+        }
 
-            tri_pts.push_back(vert[j]);
-            tri_pts.push_back(pp);
-            tri_pts.push_back(p1);
-            tri_pts.push_back(p2);
+        for (uint32_t i = 0; i <= count; i++) {
+            uint32_t base = (i % count) * rings + r;
+            *idx++ = base;
+            *idx++ = base + 1;
         }
     }
 
-    return {tri_pts, tri_idx};
+    assert(idx == line_idx.data() + line_idx.size());
+
+    return {line_vert, line_idx, GL_TRIANGLE_STRIP};
 }
 
-Shape make_shape(const std::vector<glm::vec2> &vert,
+Shape make_shape(Arena &arena,
+                 Arena &storage,
+                 std::span<const glm::vec2> vert,
                  float line_thickness,
                  const glm::vec4 &line_color,
-                 const glm::vec4 &fill_color) {
+                 const glm::vec4 &fill_color,
+                 const ShapeMeshFormat &format) {
     Shape shape;
-    {
-        auto [vertex, index] = make_fill(vert);
-        shape.fill.vertex_buffer = make_vertex_buffer(vertex, index);
-        shape.fill.color = fill_color;
-    }
 
-    {
-        auto [vertex, index] = make_line(vert, line_thickness);
-        shape.line.vertex_buffer = make_vertex_buffer(vertex, index);
-        shape.line.color = line_color;
-    }
+    ShapeLod mesh;
+    make_shape_mesh(arena, storage, vert, line_thickness, format, false, mesh);
 
-    {
-        auto [vertex, index] = make_line(vert, line_thickness * 2);
-        shape.line_highlight.vertex_buffer = make_vertex_buffer(vertex, index);
-        shape.line_highlight.color = line_color;
-    }
+    shape.fill.vertex_buffer = std::move(mesh.fill);
+    shape.line.vertex_buffer = std::move(mesh.line);
+    shape.line_highlight.vertex_buffer = std::move(mesh.line_highlight);
+
+    shape.fill.color = fill_color;
+    shape.line.color = line_color;
+    shape.line_highlight.color = line_color;
 
     shape.bbox.start = glm::vec2{-1.f, -1.f};
     shape.bbox.end = glm::vec2{1.f, 1.f};
+    shape.line_thickness = line_thickness;
+    shape.outline = store_copy(storage, vert);
 
     return shape;
 }
 
-Shape make_shape_polygon(int sides,
-                         const std::vector<float> &radius,
-                         float line_thickness,
-                         const glm::vec4 &line_color,
-                         const glm::vec4 &fill_color) {
-    std::vector<glm::vec2> vert = make_polygon(sides, radius);
+namespace {
+std::span<glm::vec2> make_outline(Arena &arena, size_t outline) {
+    const Outline &o = BUILTIN_OUTLINE[outline];
+    std::span<glm::vec2> vert = make_polygon(arena, o.sides, {o.r0, o.r1});
 
-    Shape s = make_shape(vert, line_thickness, line_color, fill_color);
+    for (auto &v : vert) {
+        v *= glm::vec2{o.sx, o.sy};
+    }
 
-    return s;
+    return vert;
 }
 
-Shape make_oval(float radius, float line_thickness, const glm::vec4 &line_color, const glm::vec4 &fill_color) {
-    Shape shape;
-
-    std::vector<glm::vec2> vert;
-
-    int sides = 36;
-    for (int i = 0; i < sides; i++) {
-        float theta = static_cast<float>(i * 2 * M_PI / sides);
-        float x = radius * std::cos(theta);
-        float y = radius * std::sin(theta) * 0.5f;
+// Meshes for BUILTIN_OUTLINE[outline], returns true if they came from the compile time table.
+// Startup does no geometry math for the default format.
+bool make_builtin_mesh(Arena &arena, Arena &storage, size_t outline, const ShapeMeshFormat &format, ShapeLod &mesh) {
+    if (format.feather && format.short_vertex && format.line_join == LineJoin::MITER) {
+        const StaticShapeMesh &m = builtin_shape_mesh(outline);
 
-        vert.push_back(glm::vec2{x, y});
+        mesh.fill = make_shape_vertex_buffer(storage, m.fill);
+        mesh.line = make_shape_vertex_buffer(storage, m.line, &mesh.line_copy);
+        mesh.line_highlight = make_shape_vertex_buffer(storage, m.line_highlight, &mesh.line_highlight_copy);
+        return true;
     }
 
-    return make_shape(vert, line_thickness, line_color, fill_color);
+    ArenaScope scope(arena);
+    make_shape_mesh(arena, storage, make_outline(arena, outline), SHAPE_LINE_THICKNESS, format, true, mesh);
+
+    return false;
 }
+}  // namespace
+
+std::vector<Shape> make_shape_set(Arena &arena,
+                                  Arena &storage,
+                                  const glm::vec4 &line_color,
+                                  std::vector<glm::vec4> color_palette,
+                                  const ShapeMeshFormat &format) {
+    // the outlines before the lods are the shape set
+    constexpr size_t num_shapes = OUTLINE_CIRCLE_LOD;
 
-std::vector<Shape> make_shape_set(const glm::vec4 &line_color, std::vector<glm::vec4> color_palette) {
-    constexpr float line_thickness = 0.1f;  // normalize
+    mesh_optimize_stats = {};
+    arena.peak = arena.used;
+    size_t storage_start = storage.used;
 
     // randomly color for each shape
     std::random_device rd;
@@ -223,78 +619,481 @@ std::vector<Shape> make_shape_set(const glm::vec4 &line_color, std::vector<glm::
     std::shuffle(color_palette.begin(), color_palette.end(), g);
 
     std::vector<Shape> ret;
+    ret.reserve(num_shapes);
 
+    size_t table_mesh = 0;  // in multiples of fill/line/line_highlight
     size_t idx = 0;
     auto next_color = [&]() -> glm::vec4 {
         idx = (idx + 1) % color_palette.size();
         return color_palette[idx];
     };
 
-    for (int sides = 3; sides <= 9; sides++) {
-        Shape s = make_shape_polygon(sides, {1.f}, line_thickness, line_color, next_color());
-        ret.push_back(std::move(s));
-    }
+    for (size_t i = 0; i < num_shapes; i++) {
+        const Outline &o = BUILTIN_OUTLINE[i];
+
+        Shape s;
+        ShapeLod mesh;
+        table_mesh += make_builtin_mesh(arena, storage, i, format, mesh);
+
+        s.fill.vertex_buffer = std::move(mesh.fill);
+        s.line.vertex_buffer = std::move(mesh.line);
+        s.line.line_copy = mesh.line_copy;
+        s.line_highlight.vertex_buffer = std::move(mesh.line_highlight);
+        s.line_highlight.line_copy = mesh.line_highlight_copy;
+
+        s.fill.color = next_color();
+        s.line.color = line_color;
+        s.line_highlight.color = line_color;
+        s.bbox.start = glm::vec2{-1.f, -1.f};
+        s.bbox.end = glm::vec2{1.f, 1.f};
+        s.line_thickness = SHAPE_LINE_THICKNESS;
+
+        {
+            ArenaScope scope(arena);
+            s.outline = store_copy<glm::vec2>(storage, make_outline(arena, i));
+        }
+
+        // circle and oval get lods, stars are exact polygons and don't need them
+        std::optional<size_t> lod_outline;
 
-    Shape circle = make_shape_polygon(36, {1.f}, line_thickness, line_color, next_color());
-    ret.push_back(std::move(circle));
+        if (i == OUTLINE_CIRCLE) {
+            lod_outline = OUTLINE_CIRCLE_LOD;
+        } else if (i == OUTLINE_OVAL) {
+            lod_outline = OUTLINE_OVAL_LOD;
+        }
 
-    Shape oval = make_oval(1.f, line_thickness, line_color, next_color());
-    ret.push_back(std::move(oval));
+        if (lod_outline) {
+            s.sdf = ShapeSdf{0, {o.sx, o.sy}};
+            s.lod.resize(NUM_LOD);
+
+            for (size_t k = 0; k < NUM_LOD; k++) {
+                ShapeLod &lod = s.lod[k];
+                lod.segments = LOD_SEGMENTS[k];
+                table_mesh += make_builtin_mesh(arena, storage, *lod_outline + k, format, lod);
+            }
+        } else {
+            s.sdf = ShapeSdf{o.sides, {o.r0, o.r1}};
+        }
 
-    for (int i = 0; i < 4; i++) {
-        Shape star = make_shape_polygon(8 + i * 2, {1.0f, 0.5f}, line_thickness, line_color, next_color());
-        ret.push_back(std::move(star));
+        ret.push_back(std::move(s));
     }
 
-    Shape rhombus = make_shape_polygon(4, {1.0f, 0.8f}, line_thickness, line_color, next_color());
-    ret.push_back(std::move(rhombus));
+    const MeshOptimizeStats &stats = mesh_optimize_stats;
+    LOG("shape set: %d meshes from the table, %d built: %d -> %d vertices, ACMR %.3f -> %.3f, %d bytes of scratch, "
+        "%d bytes of storage",
+        static_cast<int>(table_mesh * 3),
+        static_cast<int>(stats.mesh),
+        static_cast<int>(stats.vertex_before),
+        static_cast<int>(stats.vertex_after),
+        static_cast<double>(stats.acmr_before()),
+        static_cast<double>(stats.acmr_after()),
+        static_cast<int>(arena.peak),
+        static_cast<int>(storage.used - storage_start));
 
     return ret;
 }
 
-bool ShapeShader::init() {
+bool ShapeShader::init(size_t num_instance) {
     shader = make_shader(vertex_shader, fragment_shader);
-    if (shader) {
-        return true;
+    sdf_shader = make_shader(sdf_vertex_shader, sdf_fragment_shader);
+    line_batch_shader = make_shader(line_batch_vertex_shader, line_batch_fragment_shader);
+
+    if (!shader || !sdf_shader || !line_batch_shader) {
+        return false;
     }
-    return false;
+
+    std::vector<glm::vec2> quad{{-1.f, -1.f}, {1.f, -1.f}, {1.f, 1.f}, {-1.f, 1.f}};
+    sdf_quad = make_vertex_buffer(quad, {0, 1, 2, 0, 2, 3});
+
+    size_t align = uniform_buffer_offset_alignment();
+    size_t num_slot = num_instance * static_cast<size_t>(ShapePart::COUNT);
+
+    slot_stride = (sizeof(ShapeUniform) + align - 1) / align * align;
+    instance_buffer = make_uniform_buffer(slot_stride * num_slot, SHAPE_UNIFORM_BINDING);
+
+    // nothing valid has been uploaded yet, a negative scale never matches a real slot
+    uploaded.assign(num_slot, ShapeUniform{.scale = -1.0f});
+
+    line_batch = make_stream_vertex_buffer();
+    line_batch_uniform = make_uniform_buffer(sizeof(ShapeUniform) * SHAPE_LINE_BATCH_SIZE, SHAPE_LINE_BATCH_BINDING);
+
+    return true;
 }
 
-void ShapeShader::set_ortho(const glm::mat4 &ortho) {
-    assert(shader);
-    shader->use();
-    glUniformMatrix4fv(shader->get_loc("ortho_matrix"), 1, GL_FALSE, glm::value_ptr(ortho));
+bool ShapeShader::finish() {
+    for (const ShaderPtr *s : {&shader, &sdf_shader, &line_batch_shader}) {
+        if (!(*s)->finish()) {
+            return false;
+        }
+
+        (*s)->bind_uniform_block("View", VIEW_UNIFORM_BINDING);
+    }
+
+    shader->bind_uniform_block("ShapeInstance", SHAPE_UNIFORM_BINDING);
+    line_batch_shader->bind_uniform_block("ShapeLineBatch", SHAPE_LINE_BATCH_BINDING);
+
+    return true;
 }
 
-glm::vec2 normalize_pos_to_screen_pos(const ShapeShader &shader, const glm::vec2 &pos) {
-    return shader.draw_area_offset + pos * shader.draw_area_size.x;
+namespace {
+bool use_sdf(const ShapeShader &shape_shader, const Shape &shape) {
+    return shape_shader.renderer == ShapeRenderer::SDF && shape.sdf;
 }
 
-glm::vec2 screen_pos_to_normalize_pos(const ShapeShader &shader, const glm::vec2 &pos) {
-    return (pos - shader.draw_area_offset) / shader.draw_area_size.x;
+const VertexBufferPtr &shape_mesh(const Shape &shape, ShapePart part) {
+    if (!shape.lod.empty()) {
+        const ShapeLod &lod = shape.lod[shape.lod_level];
+
+        switch (part) {
+            case ShapePart::FILL:
+                return lod.fill;
+            case ShapePart::LINE:
+                return lod.line;
+            default:
+                return lod.line_highlight;
+        }
+    }
+
+    switch (part) {
+        case ShapePart::FILL:
+            return shape.fill.vertex_buffer;
+        case ShapePart::LINE:
+            return shape.line.vertex_buffer;
+        default:
+            return shape.line_highlight.vertex_buffer;
+    }
 }
 
-void draw_shape(const ShapeShader &shape_shader, const Shape &shape, bool fill, bool line, bool line_highlight) {
-    const ShaderPtr &s = shape_shader.shader;
+// Empty for FILL and for shapes not made by make_shape_set
+const ShapeLineCopy &shape_line_copy(const Shape &shape, ShapePart part) {
+    static const ShapeLineCopy none;
+
+    if (part == ShapePart::FILL) {
+        return none;
+    }
+
+    if (!shape.lod.empty()) {
+        const ShapeLod &lod = shape.lod[shape.lod_level];
+        return part == ShapePart::LINE ? lod.line_copy : lod.line_highlight_copy;
+    }
 
-    s->use();
+    return part == ShapePart::LINE ? shape.line.line_copy : shape.line_highlight.line_copy;
+}
 
+const glm::vec4 &shape_color(const Shape &shape, ShapePart part) {
+    switch (part) {
+        case ShapePart::FILL:
+            return shape.fill.color;
+        case ShapePart::LINE:
+            return shape.line.color;
+        default:
+            return shape.line_highlight.color;
+    }
+}
+
+// The SDF program has to be in use
+void set_sdf_uniforms(const ShapeShader &shape_shader,
+                      const Shape &shape,
+                      const glm::vec2 &trans,
+                      bool fill,
+                      bool line,
+                      bool line_highlight) {
+    const ShaderPtr &s = shape_shader.sdf_shader;
+    const ShapeSdf &sdf = *shape.sdf;
+
+    float line_width = 0.0f;
+    glm::vec4 line_color = shape.line.color;
+
+    if (line_highlight) {
+        line_width = shape.line_thickness * 2;
+        line_color = shape.line_highlight.color;
+    } else if (line) {
+        line_width = shape.line_thickness;
+    }
+
+    // room for the thickest line plus antialiasing
+    float extent = std::max(sdf.radius.x, sdf.radius.y) + shape.line_thickness * 2;
+
+    glUniform1f(s->get_loc("extent"), extent);
     glUniform1f(s->get_loc("scale"), shape.scale);
-    glUniform1f(s->get_loc("theta"), shape.theta);
-    glUniform2fv(s->get_loc("trans"), 1, glm::value_ptr(shape.trans));
+    glUniform1f(s->get_loc("theta0"), shape.rotation.theta0);
+    glUniform1f(s->get_loc("omega"), shape.rotation.omega);
+    glUniform1f(s->get_loc("start_time"), shape.rotation.start_time);
+    glUniform2fv(s->get_loc("trans"), 1, glm::value_ptr(trans));
+
+    glUniform1i(s->get_loc("sides"), sdf.sides);
+    glUniform2fv(s->get_loc("radius"), 1, glm::value_ptr(sdf.radius));
+    glUniform4fv(s->get_loc("fill_color"), 1, glm::value_ptr(fill ? shape.fill.color : glm::vec4{0.f}));
+    glUniform4fv(s->get_loc("line_color"), 1, glm::value_ptr(line_color));
+    glUniform1f(s->get_loc("line_width"), line_width);
+}
+
+ShapeUniform shape_uniform(const Shape &shape, const glm::vec2 &trans, ShapePart part) {
+    ShapeUniform u;
+    u.color = shape_color(shape, part);
+    u.trans = trans;
+    u.scale = shape.scale;
+    u.position_scale = shape_mesh(shape, part)->position_scale;
+    u.theta0 = shape.rotation.theta0;
+    u.omega = shape.rotation.omega;
+    u.start_time = shape.rotation.start_time;
+
+    return u;
+}
+
+// Uploads the uniform slot if it changed and binds it for the next mesh draw
+void use_shape_slot(ShapeShader &shape_shader,
+                    const Shape &shape,
+                    const glm::vec2 &trans,
+                    size_t instance,
+                    ShapePart part) {
+    size_t slot = instance * static_cast<size_t>(ShapePart::COUNT) + static_cast<size_t>(part);
+    assert(slot < shape_shader.uploaded.size());
+
+    ShapeUniform u = shape_uniform(shape, trans, part);
+    size_t offset = slot * shape_shader.slot_stride;
+
+    if (!(shape_shader.uploaded[slot] == u)) {
+        shape_shader.instance_buffer->update(&u, sizeof(u), offset);
+        shape_shader.uploaded[slot] = u;
+    }
+
+    shape_shader.instance_buffer->bind_range(SHAPE_UNIFORM_BINDING, offset, sizeof(u));
+}
 
-    if (fill) {
-        glUniform4fv(s->get_loc("color"), 1, glm::value_ptr(shape.fill.color));
-        draw_vertex_buffer(s, shape.fill.vertex_buffer);
+// The outline batch takes meshes of one vertex format until its uniform array is full
+bool line_batch_fits(const ShapeShader &shape_shader, const VertexBuffer &mesh) {
+    const VertexBuffer &batch = *shape_shader.line_batch;
+
+    if (shape_shader.line_batch_shape.empty()) {
+        return true;
     }
 
-    if (line) {
-        glUniform4fv(s->get_loc("color"), 1, glm::value_ptr(shape.line.color));
-        draw_vertex_buffer(s, shape.line.vertex_buffer);
+    return shape_shader.line_batch_shape.size() < SHAPE_LINE_BATCH_SIZE &&
+           batch.stride == mesh.stride + static_cast<GLsizei>(sizeof(float)) && batch.mode == mesh.mode;
+}
+
+// Copies the outline from its ShapeLineCopy, each vertex gets its slot in line_batch_uniform after the mesh's own
+// attributes. The outlines are separated by PRIMITIVE_RESTART_INDEX.
+void add_line_batch(ShapeShader &shape_shader, const ShapeDraw &d) {
+    const VertexBuffer &mesh = *shape_mesh(*d.shape, d.part);
+    const ShapeLineCopy &copy = shape_line_copy(*d.shape, d.part);
+    VertexBuffer &batch = *shape_shader.line_batch;
+
+    std::vector<float> &vertex = shape_shader.line_batch_vertex;
+    std::vector<uint32_t> &index = shape_shader.line_batch_index;
+    std::vector<ShapeUniform> &shape = shape_shader.line_batch_shape;
+
+    if (shape.empty()) {
+        batch.stride = mesh.stride + static_cast<GLsizei>(sizeof(float));
+        batch.mode = mesh.mode;
+        batch.position_scale = mesh.position_scale;
+        std::array<VertexAttrib, 4> &layout = shape_shader.line_batch_layout;
+        assert(mesh.layout.size() < layout.size());
+
+        std::copy(mesh.layout.begin(), mesh.layout.end(), layout.begin());
+        layout[mesh.layout.size()] = {3, 1, GL_FLOAT, GL_FALSE, static_cast<size_t>(mesh.stride)};
+        batch.layout = std::span(layout.data(), mesh.layout.size() + 1);
+    } else {
+        index.push_back(PRIMITIVE_RESTART_INDEX);
     }
 
-    if (line_highlight) {
-        glUniform4fv(s->get_loc("color"), 1, glm::value_ptr(shape.line_highlight.color));
-        draw_vertex_buffer(s, shape.line_highlight.vertex_buffer);
+    // both vertex formats are a whole number of floats
+    assert(mesh.stride % sizeof(float) == 0);
+    size_t mesh_floats = static_cast<size_t>(mesh.stride) / sizeof(float);
+    size_t batch_floats = mesh_floats + 1;
+
+    auto slot = static_cast<float>(shape.size());
+    size_t first_vertex = vertex.size() / batch_floats;
+    size_t vertex_count = copy.vertex.size() / static_cast<size_t>(mesh.stride);
+
+    vertex.resize(vertex.size() + vertex_count * batch_floats);
+    float *dst = vertex.data() + first_vertex * batch_floats;
+
+    for (size_t i = 0; i < vertex_count; i++) {
+        std::memcpy(dst, copy.vertex.data() + i * static_cast<size_t>(mesh.stride), static_cast<size_t>(mesh.stride));
+        dst[mesh_floats] = slot;
+        dst += batch_floats;
+    }
+
+    for (uint32_t idx : copy.index) {
+        index.push_back(idx == PRIMITIVE_RESTART_INDEX ? idx : static_cast<uint32_t>(first_vertex + idx));
+    }
+
+    shape.push_back(shape_uniform(*d.shape, d.trans, d.part));
+}
+
+// One draw for every outline added since the last flush, program and mesh are left bound
+void flush_line_batch(ShapeShader &shape_shader, RenderQueueStats &stats, GLuint &program, const VertexBuffer *&mesh) {
+    std::vector<ShapeUniform> &shape = shape_shader.line_batch_shape;
+
+    if (shape.empty()) {
+        return;
+    }
+
+    const VertexBufferPtr &v = shape_shader.line_batch;
+    const ShaderPtr &s = shape_shader.line_batch_shader;
+
+    v->stream(shape_shader.line_batch_vertex.data(),
+              sizeof(float) * shape_shader.line_batch_vertex.size(),
+              shape_shader.line_batch_index,
+              shape_shader.line_batch_index16);
+    shape_shader.line_batch_uniform->update(shape.data(), sizeof(ShapeUniform) * shape.size());
+
+    if (s->program != program) {
+        s->use();
+        program = s->program;
+        stats.program_changes++;
+    }
+
+    bind_vertex_buffer(v);
+    mesh = v.get();
+    stats.mesh_changes++;
+
+    draw_bound_vertex_buffer(v, 0, v->index_count);
+    stats.draws++;
+
+    shape_shader.line_batch_vertex.clear();
+    shape_shader.line_batch_index.clear();
+    shape.clear();
+}
+}  // namespace
+
+void select_lod(Shape &shape, float radius_px) {
+    if (shape.lod.empty()) {
+        return;
     }
+
+    // the highlight line sticks out the furthest
+    float r = radius_px * (1.f + shape.line_thickness);
+
+    shape.lod_level = shape.lod.size() - 1;
+
+    for (size_t i = 0; i < shape.lod.size(); i++) {
+        float chord_error = r * (1.f - std::cos(static_cast<float>(M_PI) / static_cast<float>(shape.lod[i].segments)));
+
+        if (chord_error < LOD_MAX_CHORD_ERROR_PX) {
+            shape.lod_level = i;
+            break;
+        }
+    }
+}
+
+void draw_shape(ShapeShader &shape_shader,
+                const Shape &shape,
+                size_t instance,
+                bool fill,
+                bool line,
+                bool line_highlight) {
+    if (use_sdf(shape_shader, shape)) {
+        shape_shader.sdf_shader->use();
+        set_sdf_uniforms(shape_shader, shape, shape.trans, fill, line, line_highlight);
+        draw_vertex_buffer(shape_shader.sdf_shader, shape_shader.sdf_quad);
+        return;
+    }
+
+    for (auto [part, draw] : {std::pair{ShapePart::FILL, fill},
+                              std::pair{ShapePart::LINE, line},
+                              std::pair{ShapePart::LINE_HIGHLIGHT, line_highlight}}) {
+        if (draw) {
+            use_shape_slot(shape_shader, shape, shape.trans, instance, part);
+            draw_vertex_buffer(shape_shader.shader, shape_mesh(shape, part));
+        }
+    }
+}
+
+void queue_shape(ShapeQueue &queue,
+                 const ShapeShader &shape_shader,
+                 const Shape &shape,
+                 size_t instance,
+                 bool dragged,
+                 bool fill,
+                 bool line,
+                 bool line_highlight) {
+    ShapeDraw d;
+    d.shape = &shape;
+    d.trans = shape.trans;
+    d.instance = instance;
+
+    if (use_sdf(shape_shader, shape)) {
+        // one draw does the fill and the line
+        RenderLayer layer = dragged ? RenderLayer::DRAGGED : fill ? RenderLayer::BOARD_FILL : RenderLayer::BOARD_LINE;
+
+        d.fill = fill;
+        d.line = line;
+        d.line_highlight = line_highlight;
+        queue.submit(layer, shape_shader.sdf_shader->program, 0, shape_shader.sdf_quad->vertex, d);
+        return;
+    }
+
+    for (auto [part, draw] : {std::pair{ShapePart::FILL, fill},
+                              std::pair{ShapePart::LINE, line},
+                              std::pair{ShapePart::LINE_HIGHLIGHT, line_highlight}}) {
+        if (!draw) {
+            continue;
+        }
+
+        RenderLayer layer = RenderLayer::DRAGGED;
+
+        if (!dragged) {
+            layer = part == ShapePart::FILL ? RenderLayer::BOARD_FILL : RenderLayer::BOARD_LINE;
+        }
+
+        d.part = part;
+        d.join = layer == RenderLayer::BOARD_LINE && !shape_line_copy(shape, part).index.empty();
+        queue.submit(layer, shape_shader.shader->program, 0, shape_mesh(shape, part)->vertex, d);
+    }
+}
+
+void draw_shape_queue(ShapeShader &shape_shader, ShapeQueue &queue) {
+    queue.sort();
+
+    RenderQueueStats stats;
+    GLuint program = 0;
+    const VertexBuffer *mesh = nullptr;
+
+    for (const RenderCommand &c : queue.command) {
+        const ShapeDraw &d = queue.draw[c.draw];
+        bool sdf = use_sdf(shape_shader, *d.shape);
+
+        if (!sdf && d.join) {
+            if (!line_batch_fits(shape_shader, *shape_mesh(*d.shape, d.part))) {
+                flush_line_batch(shape_shader, stats, program, mesh);
+            }
+
+            add_line_batch(shape_shader, d);
+            continue;
+        }
+
+        flush_line_batch(shape_shader, stats, program, mesh);
+
+        const ShaderPtr &s = sdf ? shape_shader.sdf_shader : shape_shader.shader;
+        const VertexBufferPtr &v = sdf ? shape_shader.sdf_quad : shape_mesh(*d.shape, d.part);
+
+        if (s->program != program) {
+            s->use();
+            program = s->program;
+            stats.program_changes++;
+        }
+
+        if (v.get() != mesh) {
+            bind_vertex_buffer(v);
+            mesh = v.get();
+            stats.mesh_changes++;
+        }
+
+        if (sdf) {
+            set_sdf_uniforms(shape_shader, *d.shape, d.trans, d.fill, d.line, d.line_highlight);
+        } else {
+            use_shape_slot(shape_shader, *d.shape, d.trans, d.instance, d.part);
+        }
+
+        draw_bound_vertex_buffer(v, 0, v->index_count);
+        stats.draws++;
+    }
+
+    flush_line_batch(shape_shader, stats, program, mesh);
+
+    queue.stats = stats;
+    queue.clear();
 }
@@ -2,17 +2,87 @@
 
 #include <SDL3/SDL_opengles2.h>
 
+#include <array>
+#include <cstddef>
 #include <glm/glm.hpp>
+#include <initializer_list>
 #include <map>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
+#include "arena.hpp"
 #include "gl_helper.hpp"
+#include "render_queue.hpp"
+
+// Vertex for the shape mesh shader.
+// extrude is in screen pixels and only used by the antialiasing fringe, see make_fill/make_line.
+struct ShapeVertex {
+    glm::vec2 pos;
+    glm::vec2 extrude{};
+    float coverage = 1.0f;  // alpha multiplier
+};
+
+enum class LineJoin { MITER, BEVEL, ROUND };
+
+// How the shape meshes are stored on the GPU
+struct ShapeMeshFormat {
+    // add a 1 pixel wide fringe with fading coverage to the mesh edges, for antialiasing without MSAA
+    bool feather = false;
+
+    // store pos/extrude as normalized GL_SHORT and coverage as GL_UNSIGNED_BYTE, 12 bytes a vertex instead of 20
+    bool short_vertex = false;
+
+    // sharp corners past the miter limit are always bevelled
+    LineJoin line_join = LineJoin::MITER;
+};
+
+// CPU copy of a line mesh, draw_shape_queue joins the board outlines into one draw from it.
+// Lives in the shape set storage, empty for meshes that aren't joined.
+struct ShapeLineCopy {
+    std::span<const std::byte> vertex;  // in the vertex format of the mesh
+    std::span<const uint32_t> index;
+};
 
 // Wrapper for GL_TRIANGLES
 struct ShapePrimitive {
     VertexBufferPtr vertex_buffer{{}, {}};
     glm::vec4 color{};
+    ShapeLineCopy line_copy;  // line meshes only
+};
+
+enum class ShapeRenderer {
+    MESH,  // triangle meshes, needs MSAA for smooth edges
+    SDF,   // one quad per shape, edges are antialiased in the fragment shader
+};
+
+// Analytic description of a shape for the SDF renderer.
+// Polygon vertex i is at angle i*2pi/sides with radius[i % 2], this covers regular polygons, stars and the rhombus.
+// sides == 0 is an ellipse with x/y radius.
+struct ShapeSdf {
+    int sides = 0;
+    glm::vec2 radius{1.0f, 1.0f};
+};
+
+// Rotation as a function of View time, computed in the vertex shader.
+// Only changes when the shape starts or stops spinning, idle frames don't touch it.
+struct ShapeRotation {
+    float theta0 = 0.0f;      // radians at start_time
+    float omega = 0.0f;       // radians per second, the sign is the direction
+    float start_time = 0.0f;  // seconds, ViewUniform::time
+
+    float at(float time) const { return theta0 + omega * (time - start_time); }
+};
+
+// One tessellation of a curved shape, the colors come from Shape::fill/line/line_highlight
+struct ShapeLod {
+    int segments = 0;
+    VertexBufferPtr fill{{}, {}};
+    VertexBufferPtr line{{}, {}};
+    VertexBufferPtr line_highlight{{}, {}};
+    ShapeLineCopy line_copy;
+    ShapeLineCopy line_highlight_copy;
 };
 
 struct Shape {
@@ -24,46 +94,188 @@ struct Shape {
     ShapePrimitive line_highlight;
     ShapePrimitive fill;
 
+    float line_thickness = 0.0f;  // line_highlight is twice as thick
+    std::span<const glm::vec2> outline;  // the polygon the meshes are made from, for hit testing
+    std::optional<ShapeSdf> sdf;  // not set for shapes only drawn as a mesh
+
+    // Curved shapes only, coarsest first. Replaces the fill/line/line_highlight mesh when not empty.
+    std::vector<ShapeLod> lod;
+    size_t lod_level = 0;
+
     glm::vec2 trans{};
     float scale = 1.0f;
-    float theta = 0.0f;  // rotation in radians
+    ShapeRotation rotation;
 };
 
+constexpr GLuint SHAPE_UNIFORM_BINDING = 1;
+
+// Per draw data of the mesh renderer, one slot per instance and mesh in ShapeShader::instance_buffer.
+// A slot is only uploaded when its data changes, drawing binds it with glBindBufferRange.
+#define SHAPE_UNIFORM_GLSL                                                               \
+    "layout(std140) uniform ShapeInstance {\n"                                           \
+    "    highp vec4 color;\n"                                                            \
+    "    highp vec2 trans; // normalized units\n"                                        \
+    "    highp float scale; // scale to apply on normalized units\n"                     \
+    "    highp float position_scale; // undoes the quantization of pos and extrude\n"    \
+    "    highp float theta0; // rotation in radians at start_time\n"                     \
+    "    highp float omega; // radians per second\n"                                     \
+    "    highp float start_time; // View time\n"                                         \
+    "};\n"
+
+struct ShapeUniform {
+    glm::vec4 color{};
+    glm::vec2 trans{};
+    float scale = 1.0f;
+    float position_scale = 1.0f;
+    float theta0 = 0.0f;
+    float omega = 0.0f;
+    float start_time = 0.0f;
+    float padding = 0.0f;  // std140 rounds the block up to a vec4
+
+    bool operator==(const ShapeUniform &) const = default;
+};
+
+static_assert(sizeof(ShapeUniform) == 48, "ShapeUniform must match the std140 layout of SHAPE_UNIFORM_GLSL");
+
+constexpr GLuint SHAPE_LINE_BATCH_BINDING = 2;
+
+// Most outlines joined into one draw, the size of the array in SHAPE_LINE_BATCH_GLSL
+constexpr size_t SHAPE_LINE_BATCH_SIZE = 32;
+
+// Narrowed indices of the outline batch, a bigger batch falls back to 32 bit
+constexpr size_t SHAPE_LINE_BATCH_INDEX16_BYTES = 64 * 1024;
+
+// Same members as SHAPE_UNIFORM_GLSL, std140 pads the struct to 48 bytes like ShapeUniform
+#define SHAPE_LINE_BATCH_GLSL                                                            \
+    "struct ShapeData {\n"                                                               \
+    "    highp vec4 color;\n"                                                            \
+    "    highp vec2 trans;\n"                                                            \
+    "    highp float scale;\n"                                                           \
+    "    highp float position_scale;\n"                                                  \
+    "    highp float theta0;\n"                                                          \
+    "    highp float omega;\n"                                                           \
+    "    highp float start_time;\n"                                                      \
+    "};\n"                                                                               \
+    "layout(std140) uniform ShapeLineBatch {\n"                                          \
+    "    ShapeData shape[32];\n"                                                         \
+    "};\n"
+
+// Meshes of an instance, in slot order
+enum class ShapePart { FILL, LINE, LINE_HIGHLIGHT, COUNT };
+
 struct ShapeShader {
     ShaderPtr shader{{}, {}};
-    glm::vec2 draw_area_offset;
-    glm::vec2 draw_area_size;
+    ShaderPtr sdf_shader{{}, {}};
+    VertexBufferPtr sdf_quad{{}, {}};
+
+    ShapeRenderer renderer = ShapeRenderer::MESH;
+
+    // ShapePart::COUNT slots per instance, see SHAPE_UNIFORM_GLSL
+    UniformBufferPtr instance_buffer{{}, {}};
+    size_t slot_stride = 0;              // sizeof(ShapeUniform) rounded up to the offset alignment
+    std::vector<ShapeUniform> uploaded;  // what's in each slot
 
-    bool init();
-    void set_ortho(const glm::mat4 &ortho);
+    // Board outlines joined into one restart separated draw, see draw_shape_queue.
+    // Each vertex carries its index into line_batch_uniform, so the outlines keep their own transform.
+    ShaderPtr line_batch_shader{{}, {}};
+    VertexBufferPtr line_batch{{}, {}};
+    UniformBufferPtr line_batch_uniform{{}, {}};
+    std::array<VertexAttrib, 4> line_batch_layout{};  // the mesh attributes plus the slot
+
+    // kept between frames to avoid allocating
+    std::vector<float> line_batch_vertex;
+    std::vector<uint32_t> line_batch_index;
+    std::vector<ShapeUniform> line_batch_shape;
+    Arena line_batch_index16{SHAPE_LINE_BATCH_INDEX16_BYTES};
+
+    // starts compiling the shader, an instance is one place a shape is drawn at, e.g. a board position
+    bool init(size_t num_instance);
+    bool finish();  // waits for it, call before drawing
 };
 
+// Memory is owned by the Arena it was made from
 struct VertexIndex {
-    std::vector<glm::vec2> vertex;
-    std::vector<uint32_t> index;
+    std::span<ShapeVertex> vertex;
+    std::span<uint32_t> index;
+    GLenum mode = GL_TRIANGLES;
 };
 
-void draw_shape(const ShapeShader &shape_shader, const Shape &shape, bool fill, bool line, bool line_highlight);
+// Enough scratch for building any one shape, including the 128 segment lod
+constexpr size_t GEOMETRY_ARENA_BYTES = 1 << 20;
+
+// Everything a shape set keeps for its lifetime besides the GL buffers: the VertexBuffer objects, the outlines and the
+// line copies. The storage arena has to outlive the shapes.
+constexpr size_t SHAPE_STORAGE_BYTES = 1 << 20;
 
-glm::vec2 normalize_pos_to_screen_pos(const ShapeShader &shader, const glm::vec2 &pos);
-glm::vec2 screen_pos_to_normalize_pos(const ShapeShader &shader, const glm::vec2 &pos);
+// Pick the coarsest lod that keeps the chord error under half a pixel, radius_px is shape.scale in screen pixels
+void select_lod(Shape &shape, float radius_px);
+
+// Uses shape_shader.renderer, shapes without a ShapeSdf are always drawn as a mesh.
+// instance picks the uniform slots, a shape drawn at the same instance as last time uploads nothing.
+void draw_shape(ShapeShader &shape_shader,
+                const Shape &shape,
+                size_t instance,
+                bool fill,
+                bool line,
+                bool line_highlight);
+
+// One mesh of a shape, or the whole shape with the SDF renderer, waiting in a ShapeQueue
+struct ShapeDraw {
+    const Shape *shape = nullptr;
+    glm::vec2 trans{};  // Shape::trans when it was queued, the same shape is drawn in more than one place
+    size_t instance = 0;
+    ShapePart part = ShapePart::FILL;  // mesh renderer
+    bool join = false;                 // board outline with a ShapeLineRange, drawn in the outline batch
+
+    // SDF renderer
+    bool fill = false;
+    bool line = false;
+    bool line_highlight = false;
+};
+
+using ShapeQueue = RenderQueue<ShapeDraw>;
+
+// Same as draw_shape but only queues the draws, see draw_shape_queue.
+// Board shapes go in BOARD_FILL and BOARD_LINE, dragged ones in DRAGGED in the order they're queued.
+void queue_shape(ShapeQueue &queue,
+                 const ShapeShader &shape_shader,
+                 const Shape &shape,
+                 size_t instance,
+                 bool dragged,
+                 bool fill,
+                 bool line,
+                 bool line_highlight);
+
+// Sorts and draws everything queued, only changing program and mesh when they differ from the last draw.
+// Consecutive board outlines of the mesh renderer are joined into one draw, see ShapeShader::line_batch.
+// Empties the queue, the counts are left in queue.stats.
+void draw_shape_queue(ShapeShader &shape_shader, ShapeQueue &queue);
 
 // Create all possible shapes for the game
 // All shapes are normalized to radius of 1.0 unit
-std::vector<Shape> make_shape_set(const glm::vec4 &line_color, std::vector<glm::vec4> color_palette);
+// The builders below allocate their output exactly once from arena, the make_shape* ones give it back on return.
+// What the shapes keep comes from storage, see SHAPE_STORAGE_BYTES.
+std::vector<Shape> make_shape_set(Arena &arena,
+                                  Arena &storage,
+                                  const glm::vec4 &line_color,
+                                  std::vector<glm::vec4> color_palette,
+                                  const ShapeMeshFormat &format = {});
+
+std::span<glm::vec2> make_polygon(Arena &arena, int sides, std::initializer_list<float> radius);
+// feather, see ShapeMeshFormat
+VertexIndex make_fill(Arena &arena, std::span<const glm::vec2> vert, bool feather = false);
 
-std::vector<glm::vec2> make_polygon(int sides, const std::vector<float> &radius);
-VertexIndex make_fill(const std::vector<glm::vec2> &vert);
-VertexIndex make_line(const std::vector<glm::vec2> &vert, float thickness);
+// Closed outline as GL_TRIANGLE_STRIP, the feather fringe strips are separated by PRIMITIVE_RESTART_INDEX
+VertexIndex make_line(Arena &arena,
+                      std::span<const glm::vec2> vert,
+                      float thickness,
+                      bool feather = false,
+                      LineJoin join = LineJoin::MITER);
 
-Shape make_shape(const std::vector<glm::vec2> &vert,
+Shape make_shape(Arena &arena,
+                 Arena &storage,
+                 std::span<const glm::vec2> vert,
                  float line_thickness,
                  const glm::vec4 &line_color,
-                 const glm::vec4 &fill_color);
-Shape make_shape_polygon(int sides,
-                         const std::vector<float> &radius,
-                         float line_thickness,
-                         const glm::vec4 &line_color,
-                         const glm::vec4 &fill_color);
-
-Shape make_oval(float radius, float line_thickness, const glm::vec4 &line_color, const glm::vec4 &fill_color);
+                 const glm::vec4 &fill_color,
+                 const ShapeMeshFormat &format = {});
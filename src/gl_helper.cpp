@@ -1,21 +1,38 @@
 #define GL_GLEXT_PROTOTYPES
 #include "gl_helper.hpp"
 
+#include <GLES3/gl3.h>
+#include <SDL3/SDL_iostream.h>
 #include <SDL3/SDL_opengles2.h>
 #include <SDL3/SDL_surface.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 #include <memory>
+#include <span>
 #include <vector>
 
 #include "log.hpp"
 
 namespace {
-bool compile_shader(GLuint s, const char *shader) {
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+bool parallel_shader_compile = false;  // GL_KHR_parallel_shader_compile
+
+// Only queues the work, the status is checked in check_shader.
+// Querying it straight away would make the driver block until the compile is done.
+void compile_shader(GLuint s, const char *shader) {
     GLint length = static_cast<GLint>(strlen(shader));
     glShaderSource(s, 1, static_cast<const GLchar **>(&shader), &length);
     glCompileShader(s);
+}
 
+bool check_shader(GLuint s) {
     GLint status = 0;
     glGetShaderiv(s, GL_COMPILE_STATUS, &status);
 
@@ -36,6 +53,215 @@ bool compile_shader(GLuint s, const char *shader) {
     return true;
 }
 
+bool check_program(GLuint program) {
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+    if (status == GL_FALSE) {
+        GLint len = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
+
+        std::vector<GLchar> error(static_cast<size_t>(len));
+        glGetProgramInfoLog(program, len, &len, error.data());
+
+        if (len > 0) {
+            LOG("check_program error: %s", error.data());
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+// Linked program binaries saved in the user's pref path.
+// The file name is a hash of the shader source and the driver strings,
+// so a driver update or a source change simply misses the cache.
+struct ProgramBinaryCache {
+    std::string dir;  // empty if disabled
+    std::string driver;
+
+    static constexpr uint32_t MAGIC = 0x53484243;  // SHBC
+
+    struct Header {
+        uint32_t magic;
+        uint32_t format;
+        uint64_t key;
+    };
+
+    uint64_t key(const std::string &vertex_code, const std::string &fragment_code) const {
+        return hash_string(driver, hash_string(fragment_code, hash_string(vertex_code)));
+    }
+
+    std::string path(uint64_t key) const {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return dir + name;
+    }
+
+#ifdef __EMSCRIPTEN__
+    // WebGL has no program binaries
+    bool load(GLuint, const std::string &, const std::string &) const { return false; }
+    void prepare(GLuint) const {}
+    void save(GLuint, const std::string &, const std::string &) const {}
+#else
+    bool load(GLuint program, const std::string &vertex_code, const std::string &fragment_code) const {
+        if (dir.empty()) {
+            return false;
+        }
+
+        uint64_t k = key(vertex_code, fragment_code);
+
+        size_t data_size;
+        uint8_t *data = static_cast<uint8_t *>(SDL_LoadFile(path(k).c_str(), &data_size));
+
+        if (!data) {
+            return false;
+        }
+
+        Header header;
+        bool ok = false;
+
+        if (data_size > sizeof(header)) {
+            memcpy(&header, data, sizeof(header));
+
+            if (header.magic == MAGIC && header.key == k) {
+                glProgramBinary(program,
+                                header.format,
+                                data + sizeof(header),
+                                static_cast<GLsizei>(data_size - sizeof(header)));
+
+                // the driver can reject a binary for reasons we can't see, e.g. a GPU change
+                GLint status = 0;
+                glGetProgramiv(program, GL_LINK_STATUS, &status);
+                ok = (status == GL_TRUE);
+            }
+        }
+
+        SDL_free(data);
+
+        if (!ok) {
+            LOG("ignoring stale program binary: %s", path(k).c_str());
+        }
+
+        return ok;
+    }
+
+    void save(GLuint program, const std::string &vertex_code, const std::string &fragment_code) const {
+        if (dir.empty()) {
+            return;
+        }
+
+        GLint len = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+
+        if (len <= 0) {
+            return;
+        }
+
+        uint64_t k = key(vertex_code, fragment_code);
+        std::vector<uint8_t> data(sizeof(Header) + static_cast<size_t>(len));
+
+        GLenum format = 0;
+        glGetProgramBinary(program, len, &len, &format, data.data() + sizeof(Header));
+
+        Header header{MAGIC, format, k};
+        memcpy(data.data(), &header, sizeof(header));
+        data.resize(sizeof(Header) + static_cast<size_t>(len));
+
+        if (!SDL_SaveFile(path(k).c_str(), data.data(), data.size())) {
+            LOG("failed to save program binary: %s", SDL_GetError());
+        }
+    }
+
+    // call before linking
+    void prepare(GLuint program) const {
+        if (!dir.empty()) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+    }
+#endif
+};
+
+ProgramBinaryCache program_binary_cache;
+
+// Index data ready for upload, narrowed to 16 bit when possible.
+// 16 bit indices halve the index bandwidth and don't need OES_element_index_uint on WebGL 1.
+struct IndexData {
+    GLenum type = GL_UNSIGNED_INT;
+    const void *data = nullptr;  // valid until scratch is rewound
+    size_t bytes = 0;
+};
+
+// The narrowed copy is allocated from scratch. force_type is for updating a buffer in place, 0 picks the smallest type
+// that scratch has room for.
+IndexData pack_index(Arena &scratch, std::span<const uint32_t> index, GLenum force_type = 0) {
+    IndexData ret;
+
+    // 0xffff is the restart index for 16 bit
+    auto fits_short = [](uint32_t i) { return i < 0xffff || i == PRIMITIVE_RESTART_INDEX; };
+    bool fits = std::all_of(index.begin(), index.end(), fits_short) && scratch.fits<uint16_t>(index.size());
+
+    if ((force_type == 0 && fits) || force_type == GL_UNSIGNED_SHORT) {
+        std::span<uint16_t> narrow = scratch.alloc<uint16_t>(index.size());
+
+        for (size_t i = 0; i < index.size(); i++) {
+            assert(fits_short(index[i]));
+            narrow[i] = static_cast<uint16_t>(index[i]);  // PRIMITIVE_RESTART_INDEX truncates to 0xffff
+        }
+
+        ret.type = GL_UNSIGNED_SHORT;
+        ret.data = narrow.data();
+        ret.bytes = narrow.size_bytes();
+    } else {
+        ret.data = index.data();
+        ret.bytes = sizeof(uint32_t) * index.size();
+    }
+
+    return ret;
+}
+
+IndexData wide_index(std::span<const uint32_t> index) { return {GL_UNSIGNED_INT, index.data(), index.size_bytes()}; }
+
+size_t index_type_bytes(GLenum type) { return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+// Enable attribute arrays [0, count) and disable the rest,
+// so nothing is left pointing at a buffer the draw doesn't use.
+void enable_vertex_attrib_arrays(GLuint count) {
+    constexpr GLuint max_used = 4;
+
+    for (GLuint i = 0; i < max_used; i++) {
+        if (i < count) {
+            glEnableVertexAttribArray(i);
+        } else {
+            glDisableVertexAttribArray(i);
+        }
+    }
+}
+
+std::string add_defines(const char *code, const std::vector<std::string> &defines) {
+    std::string src(code);
+
+    if (defines.empty()) {
+        return src;
+    }
+
+    std::string str;
+    for (const auto &d : defines) {
+        str += "#define " + d + "\n";
+    }
+
+    // #version has to be the first line
+    size_t pos = 0;
+    if (src.rfind("#version", 0) == 0) {
+        pos = src.find('\n') + 1;
+    }
+
+    src.insert(pos, str);
+
+    return src;
+}
+
 #ifdef __linux__
 void debug_callback(GLenum source,
                     GLenum type,
@@ -67,6 +293,50 @@ void enable_gl_debug_callback() {
 #endif
 }
 
+void enable_primitive_restart() {
+#ifndef __EMSCRIPTEN__
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+#endif
+}
+
+void enable_program_binary_cache(const std::string &dir) {
+#ifdef __EMSCRIPTEN__
+    (void)dir;
+#else
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+    if (num_formats <= 0) {
+        LOG("program binary cache disabled, driver supports no binary formats");
+        return;
+    }
+
+    auto gl_str = [](GLenum name) {
+        const GLubyte *str = glGetString(name);
+        return str ? std::string(reinterpret_cast<const char *>(str)) : std::string();
+    };
+
+    program_binary_cache.dir = dir;
+    program_binary_cache.driver = gl_str(GL_VENDOR) + "\n" + gl_str(GL_RENDERER) + "\n" + gl_str(GL_VERSION);
+#endif
+}
+
+void enable_parallel_shader_compile() {
+    if (!SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        return;
+    }
+
+    using MaxShaderCompilerThreads = void(GL_APIENTRY *)(GLuint);
+    auto max_threads =
+        reinterpret_cast<MaxShaderCompilerThreads>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+
+    if (max_threads) {
+        max_threads(0xFFFFFFFF);  // let the driver decide
+    }
+
+    parallel_shader_compile = true;
+}
+
 void VertexArray::use() { glBindVertexArrayOES(vao); }
 
 VertexArrayPtr make_vertex_array() {
@@ -82,7 +352,49 @@ VertexArrayPtr make_vertex_array() {
     return v;
 }
 
-void Shader::use() const { glUseProgram(program); }
+void Shader::use() const {
+    assert(!pending);
+    glUseProgram(program);
+}
+
+bool Shader::ready() const {
+    if (!pending || !parallel_shader_compile) {
+        return true;
+    }
+
+    GLint done = GL_FALSE;
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+
+    return done == GL_TRUE;
+}
+
+bool Shader::finish() {
+    if (!pending) {
+        return linked;
+    }
+
+    if (!ready()) {
+        LOG("waiting for shader program %d to link", program);
+    }
+
+    pending = false;
+
+    if (!check_shader(vertex)) {
+        LOG("failed to compile vertex shader");
+    } else if (!check_shader(fragment)) {
+        LOG("failed to compile fragment shader");
+    } else if (!check_program(program)) {
+        LOG("failed to link shader program");
+    } else {
+        linked = true;
+        program_binary_cache.save(program, vertex_src, fragment_src);
+    }
+
+    vertex_src = {};
+    fragment_src = {};
+
+    return linked;
+}
 
 GLint Shader::get_loc(const char *name) const {
     GLint ret = glGetUniformLocation(program, name);
@@ -90,7 +402,15 @@ GLint Shader::get_loc(const char *name) const {
     return ret;
 }
 
-ShaderPtr make_shader(const char *vertex_code, const char *fragment_code) {
+void Shader::bind_uniform_block(const char *name, GLuint binding) const {
+    GLuint block = glGetUniformBlockIndex(program, name);
+
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, binding);
+    }
+}
+
+ShaderPtr make_shader(const char *vertex_code, const char *fragment_code, const std::vector<std::string> &defines) {
     auto cleanup = [](Shader *s) {
         LOG("deleting shader: %d %d %d", s->program, s->vertex, s->fragment);
         glDeleteShader(s->vertex);
@@ -100,27 +420,73 @@ ShaderPtr make_shader(const char *vertex_code, const char *fragment_code) {
 
     ShaderPtr s(new Shader, cleanup);
 
+    s->vertex_src = add_defines(vertex_code, defines);
+    s->fragment_src = add_defines(fragment_code, defines);
+
     s->program = glCreateProgram();
-    s->vertex = glCreateShader(GL_VERTEX_SHADER);
-    s->fragment = glCreateShader(GL_FRAGMENT_SHADER);
 
-    if (!compile_shader(s->vertex, vertex_code)) {
-        LOG("failed to compile vertex shader");
-        return {{}, cleanup};
+    if (program_binary_cache.load(s->program, s->vertex_src, s->fragment_src)) {
+        s->linked = true;
+        s->vertex_src = {};
+        s->fragment_src = {};
+        return s;
     }
 
-    if (!compile_shader(s->fragment, fragment_code)) {
-        LOG("failed to compile fragment shader");
-        return {{}, cleanup};
-    }
+    s->vertex = glCreateShader(GL_VERTEX_SHADER);
+    s->fragment = glCreateShader(GL_FRAGMENT_SHADER);
+
+    compile_shader(s->vertex, s->vertex_src.c_str());
+    compile_shader(s->fragment, s->fragment_src.c_str());
 
     glAttachShader(s->program, s->vertex);
     glAttachShader(s->program, s->fragment);
+
+    program_binary_cache.prepare(s->program);
     glLinkProgram(s->program);
 
+    s->pending = true;
+
     return s;
 }
 
+const ShaderPtr &ShaderCache::get(const char *vertex_code,
+                                  const char *fragment_code,
+                                  const std::vector<std::string> &defines) {
+    uint64_t key = hash_string(fragment_code, hash_string(vertex_code));
+    for (const auto &d : defines) {
+        key = hash_string(d, hash_string("\n", key));
+    }
+
+    auto it = variant.find(key);
+
+    if (it == variant.end()) {
+        it = variant.emplace(key, make_shader(vertex_code, fragment_code, defines)).first;
+    }
+
+    return it->second;
+}
+
+bool ShaderCache::finish() {
+    bool ok = true;
+
+    for (auto &v : variant) {
+        ok = v.second->finish() && ok;
+    }
+
+    return ok;
+}
+
+uint64_t hash_string(std::string_view str, uint64_t seed) {
+    uint64_t h = seed;
+
+    for (char c : str) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ull;
+    }
+
+    return h;
+}
+
 TexturePtr make_texture(const std::string &bmp_path) {
     SDL_Surface *bmp = SDL_LoadBMP(bmp_path.c_str());
     if (!bmp) {
@@ -151,20 +517,135 @@ TexturePtr make_texture(const std::string &bmp_path) {
     return t;
 }
 
-void Texture::use() const {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, id);
+RenderTargetPtr make_render_target(int width, int height, int samples) {
+    auto cleanup = [](RenderTarget *r) {
+        LOG("deleting render target: %d(%dx%d, %d samples)", r->fbo, r->texture->width, r->texture->height, r->samples);
+        glDeleteFramebuffers(1, &r->fbo);
+        glDeleteFramebuffers(1, &r->resolve_fbo);
+        glDeleteRenderbuffers(1, &r->renderbuffer);
+    };
+
+    auto texture_cleanup = [](Texture *t) { glDeleteTextures(1, &t->id); };
+
+    RenderTargetPtr r(new RenderTarget, cleanup);
+
+    r->texture = TexturePtr(new Texture, texture_cleanup);
+    r->texture->width = width;
+    r->texture->height = height;
+    r->samples = samples > 1 ? samples : 0;
+
+    glGenTextures(1, &r->texture->id);
+    glBindTexture(GL_TEXTURE_2D, r->texture->id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    GLuint texture_fbo = 0;
+    glGenFramebuffers(1, &texture_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, texture_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, r->texture->id, 0);
+
+    if (r->samples > 0) {
+        r->resolve_fbo = texture_fbo;
+
+        glGenRenderbuffers(1, &r->renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, r->renderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, r->samples, GL_RGBA8, width, height);
+
+        glGenFramebuffers(1, &r->fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, r->fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, r->renderbuffer);
+    } else {
+        r->fbo = texture_fbo;
+    }
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        LOG("render target %dx%d with %d samples is incomplete: 0x%x", width, height, samples, status);
+        return {{}, {}};
+    }
+
+    return r;
 }
 
-VertexBufferPtr make_vertex_buffer(const std::vector<glm::vec2> &vertex, const std::vector<uint32_t> &index) {
-    return make_vertex_buffer(glm::value_ptr(vertex[0]), sizeof(glm::vec2) * vertex.size(), index);
+void RenderTarget::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, texture->width, texture->height);
 }
 
-VertexBufferPtr make_vertex_buffer(const std::vector<glm::vec4> &vertex, const std::vector<uint32_t> &index) {
-    return make_vertex_buffer(glm::value_ptr(vertex[0]), sizeof(glm::vec4) * vertex.size(), index);
+void RenderTarget::resolve() const {
+    if (samples == 0) {
+        return;
+    }
+
+    int w = texture->width;
+    int h = texture->height;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_fbo);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void bind_default_framebuffer(int width, int height) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+UniformBufferPtr make_uniform_buffer(size_t bytes, GLuint binding) {
+    auto cleanup = [](UniformBuffer *u) {
+        LOG("deleting uniform buffer: %d(%d bytes)", u->id, static_cast<int>(u->bytes));
+        glDeleteBuffers(1, &u->id);
+    };
+
+    UniformBufferPtr u(new UniformBuffer, cleanup);
+
+    glGenBuffers(1, &u->id);
+    glBindBuffer(GL_UNIFORM_BUFFER, u->id);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, u->id);
+    u->bytes = bytes;
+
+    return u;
+}
+
+void UniformBuffer::update(const void *data, size_t data_bytes, size_t offset) const {
+    assert(offset + data_bytes <= bytes);
+    glBindBuffer(GL_UNIFORM_BUFFER, id);
+    glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(data_bytes), data);
+}
+
+void UniformBuffer::bind_range(GLuint binding, size_t offset, size_t range_bytes) const {
+    assert(offset + range_bytes <= bytes);
+    assert(offset % uniform_buffer_offset_alignment() == 0);
+    glBindBufferRange(
+        GL_UNIFORM_BUFFER, binding, id, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(range_bytes));
+}
+
+size_t uniform_buffer_offset_alignment() {
+    static GLint alignment = 0;
+
+    if (alignment == 0) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = std::max(alignment, 1);
+    }
+
+    return static_cast<size_t>(alignment);
 }
 
-VertexBufferPtr make_vertex_buffer(const float *vertex, size_t vertex_bytes, const std::vector<uint32_t> &index) {
+void Texture::use() const {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, id);
+}
+
+namespace {
+// storage is nullptr for a heap allocated VertexBuffer
+VertexBufferPtr make_vertex_buffer(
+    VertexBuffer *storage, const void *vertex, size_t vertex_bytes, const IndexData &index, size_t index_count) {
     auto cleanup = [](VertexBuffer *v) {
         LOG("deleting vertex and index buffer: %d(%d bytes) %d(%d count)",
             v->vertex,
@@ -175,7 +656,7 @@ VertexBufferPtr make_vertex_buffer(const float *vertex, size_t vertex_bytes, con
         glDeleteBuffers(1, &v->index);
     };
 
-    VertexBufferPtr v(new VertexBuffer, cleanup);
+    VertexBufferPtr v(storage ? storage : new VertexBuffer, cleanup);
 
     glGenBuffers(1, &v->vertex);
     glBindBuffer(GL_ARRAY_BUFFER, v->vertex);
@@ -184,39 +665,116 @@ VertexBufferPtr make_vertex_buffer(const float *vertex, size_t vertex_bytes, con
 
     glGenBuffers(1, &v->index);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, v->index);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 static_cast<GLsizeiptr>(sizeof(uint32_t) * index.size()),
-                 index.data(),
-                 GL_STATIC_DRAW);
-    v->index_count = index.size();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index.bytes), index.data, GL_STATIC_DRAW);
+    v->index_bytes = index.bytes;
+    v->index_count = index_count;
+    v->index_type = index.type;
 
     return v;
 }
+}  // namespace
+
+VertexBufferPtr make_vertex_buffer(const std::vector<glm::vec2> &vertex, const std::vector<uint32_t> &index) {
+    return make_vertex_buffer(
+        nullptr, glm::value_ptr(vertex[0]), sizeof(glm::vec2) * vertex.size(), wide_index(index), index.size());
+}
+
+VertexBufferPtr make_vertex_buffer(const std::vector<glm::vec4> &vertex, const std::vector<uint32_t> &index) {
+    return make_vertex_buffer(
+        nullptr, glm::value_ptr(vertex[0]), sizeof(glm::vec4) * vertex.size(), wide_index(index), index.size());
+}
+
+VertexBufferPtr make_vertex_buffer(
+    Arena &scratch, Arena &storage, const void *vertex, size_t vertex_bytes, std::span<const uint32_t> index) {
+    ArenaScope scope(scratch);
+    VertexBuffer *v = storage.alloc<VertexBuffer>(1).data();
+
+    return make_vertex_buffer(v, vertex, vertex_bytes, pack_index(scratch, index), index.size());
+}
+
+VertexBufferPtr make_vertex_buffer(Arena &storage,
+                                   const void *vertex,
+                                   size_t vertex_bytes,
+                                   std::span<const uint16_t> index) {
+    IndexData packed{GL_UNSIGNED_SHORT, index.data(), index.size_bytes()};
+    VertexBuffer *v = storage.alloc<VertexBuffer>(1).data();
+
+    return make_vertex_buffer(v, vertex, vertex_bytes, packed, index.size());
+}
+
+VertexBufferPtr make_stream_vertex_buffer() { return make_vertex_buffer(nullptr, nullptr, 0, IndexData{}, 0); }
 
 void VertexBuffer::use() const {
     glBindBuffer(GL_ARRAY_BUFFER, vertex);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index);
 }
 
-void VertexBuffer::update_vertex(const float *v, size_t v_bytes, const std::vector<uint32_t> &optional_idx) {
+void VertexBuffer::update_vertex(const float *v,
+                                 size_t v_bytes,
+                                 Arena &scratch,
+                                 const std::vector<uint32_t> &optional_idx) {
     glBindBuffer(GL_ARRAY_BUFFER, vertex);
     glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(v_bytes), v);
 
     if (!optional_idx.empty()) {
+        ArenaScope scope(scratch);
+        IndexData packed = pack_index(scratch, optional_idx, index_type);
+
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index);
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(optional_idx.size()), optional_idx.data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(packed.bytes), packed.data);
         index_count = optional_idx.size();
     }
 }
 
+void VertexBuffer::stream(const float *v, size_t v_bytes, const std::vector<uint32_t> &idx, Arena &scratch) {
+    ArenaScope scope(scratch);
+    IndexData packed = pack_index(scratch, idx);
+
+    vertex_bytes = std::max(vertex_bytes, v_bytes);
+    index_bytes = std::max(index_bytes, packed.bytes);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertex_bytes), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(v_bytes), v);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_bytes), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(packed.bytes), packed.data);
+
+    index_count = idx.size();
+    index_type = packed.type;
+}
+
 void draw_vertex_buffer(const ShaderPtr &shader, const VertexBufferPtr &v, const TexturePtr &optional_tex) {
+    draw_vertex_buffer(shader, v, optional_tex, 0, v->index_count);
+}
+
+void draw_vertex_buffer(const ShaderPtr &shader,
+                        const VertexBufferPtr &v,
+                        const TexturePtr &optional_tex,
+                        size_t index_offset,
+                        size_t index_count) {
     shader->use();
 
     if (optional_tex) {
         optional_tex->use();
+    }
+
+    bind_vertex_buffer(v, static_cast<bool>(optional_tex));
+    draw_bound_vertex_buffer(v, index_offset, index_count);
+}
 
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
+void bind_vertex_buffer(const VertexBufferPtr &v, bool uv) {
+    if (!v->layout.empty()) {
+        enable_vertex_attrib_arrays(static_cast<GLuint>(v->layout.size()));
+
+        v->use();
+        for (const auto &a : v->layout) {
+            glVertexAttribPointer(
+                a.location, a.size, a.type, a.normalized, v->stride, reinterpret_cast<void *>(a.offset));
+        }
+    } else if (uv) {
+        enable_vertex_attrib_arrays(2);
 
         int stride = sizeof(float) * 4;
         int uv_offset = sizeof(float) * 2;
@@ -225,12 +783,17 @@ void draw_vertex_buffer(const ShaderPtr &shader, const VertexBufferPtr &v, const
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, 0);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(uv_offset));
     } else {
-        glEnableVertexAttribArray(0);
+        enable_vertex_attrib_arrays(1);
         v->use();
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
     }
+}
 
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(v->index_count), GL_UNSIGNED_INT, 0);
+void draw_bound_vertex_buffer(const VertexBufferPtr &v, size_t index_offset, size_t index_count) {
+    glDrawElements(v->mode,
+                   static_cast<GLsizei>(index_count),
+                   v->index_type,
+                   reinterpret_cast<void *>(index_type_bytes(v->index_type) * index_offset));
 }
 
 std::pair<glm::vec2, glm::vec2> bbox(const std::vector<glm::vec4> &vertex) {
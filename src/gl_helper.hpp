@@ -5,10 +5,15 @@
 
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
+#include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "arena.hpp"
+
 // Light wrapper around common OpenGL types.
 // The unique_ptr will delete the OpenGL object automatically.
 
@@ -20,17 +25,69 @@ struct VertexArray {
 using VertexArrayPtr = std::unique_ptr<VertexArray, void (*)(VertexArray *)>;
 VertexArrayPtr make_vertex_array();
 
+// Compile and link are only queued by make_shader, so several programs can build in parallel
+// (GL_KHR_parallel_shader_compile) while the app does other work. Call finish() before first use.
 struct Shader {
     GLuint program = 0;
     GLuint vertex = 0;
     GLuint fragment = 0;
 
+    bool pending = false;  // compile/link status not checked yet
+    bool linked = false;
+
+    // final source, kept for the program binary cache until finish()
+    std::string vertex_src;
+    std::string fragment_src;
+
+    bool ready() const;  // true if finish() won't block, always true without GL_KHR_parallel_shader_compile
+    bool finish();       // wait for compile + link, returns false on error
+
     void use() const;                       // glUseProgram
     GLint get_loc(const char *name) const;  // glGetUniformLocation
+
+    // glUniformBlockBinding, does nothing if the program has no such block
+    void bind_uniform_block(const char *name, GLuint binding) const;
 };
 
 using ShaderPtr = std::unique_ptr<Shader, void (*)(Shader *)>;
-ShaderPtr make_shader(const char *vertex_code, const char *fragment_code);
+
+// Returns a pending shader, see Shader::finish.
+// defines are injected after the #version line, e.g. {"OUTLINE", "MAX_SIDES 36"}
+ShaderPtr make_shader(const char *vertex_code, const char *fragment_code, const std::vector<std::string> &defines = {});
+
+// Specialized variants of a shader, compiled once on first use and keyed by source + defines.
+// Prefer this over runtime branching on uniforms that rarely change.
+// get() hashes the whole source, look variants up at init and keep the result rather than calling it per draw.
+struct ShaderCache {
+    std::map<uint64_t, ShaderPtr> variant;
+
+    const ShaderPtr &get(const char *vertex_code,
+                         const char *fragment_code,
+                         const std::vector<std::string> &defines = {});
+
+    bool finish();  // Shader::finish on all variants
+};
+
+// FNV-1a, chain calls by passing the previous result as seed
+uint64_t hash_string(std::string_view str, uint64_t seed = 14695981039346656037ull);
+
+struct UniformBuffer {
+    GLuint id = 0;
+    size_t bytes = 0;
+
+    void update(const void *data, size_t data_bytes, size_t offset = 0) const;  // glBufferSubData
+
+    // glBindBufferRange, offset must be a multiple of uniform_buffer_offset_alignment()
+    void bind_range(GLuint binding, size_t offset, size_t range_bytes) const;
+};
+
+using UniformBufferPtr = std::unique_ptr<UniformBuffer, void (*)(UniformBuffer *)>;
+
+// The buffer stays bound to the binding point for the lifetime of the app, unless bind_range moves it
+UniformBufferPtr make_uniform_buffer(size_t bytes, GLuint binding);
+
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+size_t uniform_buffer_offset_alignment();
 
 struct Texture {
     GLuint id = 0;
@@ -43,31 +100,105 @@ struct Texture {
 using TexturePtr = std::unique_ptr<Texture, void (*)(Texture *)>;
 TexturePtr make_texture(const std::string &bmp_path);
 
+// Offscreen color target that can be sampled as a texture.
+// With samples > 1 drawing goes to a multisampled renderbuffer and resolve() copies it to the texture.
+struct RenderTarget {
+    GLuint fbo = 0;           // what to draw into
+    GLuint resolve_fbo = 0;   // samples > 1 only, the texture is attached to it
+    GLuint renderbuffer = 0;  // samples > 1 only
+    TexturePtr texture{{}, {}};
+    int samples = 0;
+
+    void bind() const;     // glBindFramebuffer and a viewport covering the texture
+    void resolve() const;  // does nothing without samples, call after drawing and before sampling the texture
+};
+
+using RenderTargetPtr = std::unique_ptr<RenderTarget, void (*)(RenderTarget *)>;
+
+// RGBA8, returns null if the framebuffer isn't complete
+RenderTargetPtr make_render_target(int width, int height, int samples = 0);
+
+// Back to the window, viewport in window pixels
+void bind_default_framebuffer(int width, int height);
+
+// Ends a strip and starts the next in the same draw.
+// Needs GL_PRIMITIVE_RESTART_FIXED_INDEX, see enable_primitive_restart. Mapped to 0xffff for 16 bit indices.
+constexpr uint32_t PRIMITIVE_RESTART_INDEX = 0xffffffff;
+
+struct VertexAttrib {
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
 // This is general enough to represent all the drawing combos we need.
 // - vertex only
 // - vertex + texture uv
 // - vertex + color
+// - anything else described by layout
 struct VertexBuffer {
     GLuint vertex = 0;
     GLuint index = 0;
 
+    // empty for vertex only, or vertex + texture uv when drawn with a texture
+    // locations have to start from 0 and be contiguous, usually a constant table that outlives the buffer
+    std::span<const VertexAttrib> layout;
+    GLsizei stride = 0;
+
+    // multiplier for positions stored as normalized integers, for the shader to undo the quantization
+    float position_scale = 1.0f;
+
     size_t vertex_bytes = 0;
+    size_t index_bytes = 0;
     size_t index_count = 0;
+    GLenum index_type = GL_UNSIGNED_INT;  // GL_UNSIGNED_SHORT when all the indices fit
+    GLenum mode = GL_TRIANGLES;
 
     void use() const;
+
+    // pos + texture uv, scratch holds the narrowed indices of a 16 bit buffer during the upload
     void update_vertex(const float *v,
                        size_t v_bytes,
-                       const std::vector<uint32_t> &optional_index = {});  // pos + texture uv
+                       Arena &scratch,
+                       const std::vector<uint32_t> &optional_index = {});
+
+    // Replace the whole content with per-frame data.
+    // The old storage is orphaned so the driver doesn't stall on draws still using it.
+    // Indices are narrowed to 16 bit in scratch when they fit and there's room, scratch is rewound on return.
+    void stream(const float *v, size_t v_bytes, const std::vector<uint32_t> &index, Arena &scratch);
 };
 
 using VertexBufferPtr = std::unique_ptr<VertexBuffer, void (*)(VertexBuffer *)>;
 
+// Indices are stored as 32 bit, for the odd quad
 VertexBufferPtr make_vertex_buffer(const std::vector<glm::vec2> &vertex, const std::vector<uint32_t> &index);
 VertexBufferPtr make_vertex_buffer(const std::vector<glm::vec4> &vertex,
                                    const std::vector<uint32_t> &index);  // pos + texture uv
-VertexBufferPtr make_vertex_buffer(const float *vertex, size_t vertex_bytes, const std::vector<uint32_t> &index);
+
+// For meshes built in bulk, e.g. a shape set. The VertexBuffer object is allocated from storage, which has to outlive
+// it. Indices are stored as 16 bit when they fit, narrowed in scratch.
+VertexBufferPtr make_vertex_buffer(
+    Arena &scratch, Arena &storage, const void *vertex, size_t vertex_bytes, std::span<const uint32_t> index);
+// Uploaded as is, e.g. straight from read-only data
+VertexBufferPtr make_vertex_buffer(Arena &storage,
+                                   const void *vertex,
+                                   size_t vertex_bytes,
+                                   std::span<const uint16_t> index);
+VertexBufferPtr make_stream_vertex_buffer();  // empty, filled by VertexBuffer::stream
 
 void draw_vertex_buffer(const ShaderPtr &shader, const VertexBufferPtr &v, const TexturePtr &optional_tex = {{}, {}});
+void draw_vertex_buffer(const ShaderPtr &shader,
+                        const VertexBufferPtr &v,
+                        const TexturePtr &optional_tex,
+                        size_t index_offset,
+                        size_t index_count);
+
+// The two halves of draw_vertex_buffer, for callers that skip redundant state changes, e.g. a sorted RenderQueue.
+// uv is for vertex + texture uv buffers without a layout.
+void bind_vertex_buffer(const VertexBufferPtr &v, bool uv = false);
+void draw_bound_vertex_buffer(const VertexBufferPtr &v, size_t index_offset, size_t index_count);
 
 struct BBox {
     glm::vec2 start;
@@ -93,3 +224,14 @@ BBox bbox(const std::vector<GLM_VEC> &vertex) {
 }
 
 void enable_gl_debug_callback();
+
+// Always on in WebGL 2, has to be enabled on GLES 3
+void enable_primitive_restart();
+
+// Let the driver compile shaders on its own threads, if GL_KHR_parallel_shader_compile is supported.
+// Call once the GL context is current and before any make_shader.
+void enable_parallel_shader_compile();
+
+// Save linked programs in dir (with trailing slash) and reuse them on later launches.
+// Call once the GL context is current. Does nothing if the driver has no binary formats.
+void enable_program_binary_cache(const std::string &dir);
@@ -0,0 +1,181 @@
+#include "hit_test.hpp"
+
+#include <SDL3/SDL_timer.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+#include "log.hpp"
+
+namespace {
+// > 0 if p is left of the line a -> b
+float is_left(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &p) {
+    return (b.x - a.x) * (p.y - a.y) - (p.x - a.x) * (b.y - a.y);
+}
+
+float distance_to_segment_sq(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &p) {
+    glm::vec2 ab = b - a;
+    float len_sq = glm::dot(ab, ab);
+    float t = len_sq > 0 ? std::clamp(glm::dot(p - a, ab) / len_sq, 0.f, 1.f) : 0.f;
+    glm::vec2 d = a + ab * t - p;
+
+    return glm::dot(d, d);
+}
+}  // namespace
+
+bool hit_test(const HitTarget &target, const glm::vec2 &p, float theta) {
+    if (target.outline.empty() || target.scale <= 0) {
+        return false;
+    }
+
+    // into shape units, inverse of draw_shape's rotation*p*scale + trans
+    float c = std::cos(theta);
+    float s = std::sin(theta);
+    glm::vec2 d = (p - target.trans) / target.scale;
+    glm::vec2 q{c * d.x + s * d.y, -s * d.x + c * d.y};
+
+    std::span<const glm::vec2> vert = target.outline;
+    float margin_sq = target.margin * target.margin;
+    int winding_number = 0;
+
+    for (size_t i = 0; i < vert.size(); i++) {
+        const glm::vec2 &a = vert[i];
+        const glm::vec2 &b = vert[(i + 1) % vert.size()];
+
+        if (a.y <= q.y) {
+            if (b.y > q.y && is_left(a, b, q) > 0) {
+                winding_number++;
+            }
+        } else if (b.y <= q.y && is_left(a, b, q) < 0) {
+            winding_number--;
+        }
+
+        if (margin_sq > 0 && distance_to_segment_sq(a, b, q) <= margin_sq) {
+            return true;
+        }
+    }
+
+    return winding_number != 0;
+}
+
+int HitGrid::cell_x(float x) const {
+    return std::clamp(static_cast<int>(std::floor((x - origin.x) * inv_cell_size)), 0, cols - 1);
+}
+
+int HitGrid::cell_y(float y) const {
+    return std::clamp(static_cast<int>(std::floor((y - origin.y) * inv_cell_size)), 0, rows - 1);
+}
+
+void HitGrid::build(const BBox &area, float cell_size, std::vector<HitTarget> new_target) {
+    assert(cell_size > 0);
+
+    target = std::move(new_target);
+    origin = area.start;
+    inv_cell_size = 1.0f / cell_size;
+
+    glm::vec2 size = area.end - area.start;
+    cols = std::max(1, static_cast<int>(std::ceil(size.x * inv_cell_size)));
+    rows = std::max(1, static_cast<int>(std::ceil(size.y * inv_cell_size)));
+
+    bound_radius.resize(target.size());
+
+    for (size_t i = 0; i < target.size(); i++) {
+        float r = 0;
+
+        for (const auto &v : target[i].outline) {
+            r = std::max(r, glm::length(v));
+        }
+
+        bound_radius[i] = (r + target[i].margin) * target[i].scale;
+    }
+
+    // counting sort of the targets into cells, first pass counts and second fills
+    size_t num_cell = static_cast<size_t>(cols * rows);
+    cell_start.assign(num_cell + 1, 0);
+
+    auto for_each_cell = [&](size_t i, auto func) {
+        glm::vec2 r{bound_radius[i], bound_radius[i]};
+        glm::vec2 start = target[i].trans - r;
+        glm::vec2 end = target[i].trans + r;
+
+        for (int y = cell_y(start.y); y <= cell_y(end.y); y++) {
+            for (int x = cell_x(start.x); x <= cell_x(end.x); x++) {
+                func(static_cast<size_t>(y * cols + x));
+            }
+        }
+    };
+
+    for (size_t i = 0; i < target.size(); i++) {
+        for_each_cell(i, [&](size_t cell) { cell_start[cell + 1]++; });
+    }
+
+    for (size_t c = 0; c < num_cell; c++) {
+        cell_start[c + 1] += cell_start[c];
+    }
+
+    std::vector<uint32_t> fill(cell_start.begin(), cell_start.end() - 1);
+    cell_target.resize(cell_start.back());
+
+    // in target order, so find() returns the same target as a linear scan would
+    for (size_t i = 0; i < target.size(); i++) {
+        for_each_cell(i, [&](size_t cell) { cell_target[fill[cell]++] = static_cast<uint32_t>(i); });
+    }
+}
+
+std::optional<size_t> HitGrid::find(const glm::vec2 &p, float time) const {
+    if (target.empty()) {
+        return {};
+    }
+
+    size_t cell = static_cast<size_t>(cell_y(p.y) * cols + cell_x(p.x));
+
+    for (uint32_t k = cell_start[cell]; k < cell_start[cell + 1]; k++) {
+        uint32_t i = cell_target[k];
+        const HitTarget &t = target[i];
+        glm::vec2 d = p - t.trans;
+
+        if (glm::dot(d, d) > bound_radius[i] * bound_radius[i]) {
+            continue;
+        }
+
+        float theta = t.rotation ? t.rotation->at(time) : 0.0f;
+
+        if (hit_test(t, p, theta)) {
+            return t.id;
+        }
+    }
+
+    return {};
+}
+
+double benchmark_hit_grid(const HitGrid &grid, const BBox &area, int queries, float time) {
+    std::mt19937 g(1234);
+    std::uniform_real_distribution<float> rand_x(area.start.x, area.end.x);
+    std::uniform_real_distribution<float> rand_y(area.start.y, area.end.y);
+
+    std::vector<glm::vec2> point(static_cast<size_t>(queries));
+
+    for (auto &p : point) {
+        p = glm::vec2{rand_x(g), rand_y(g)};
+    }
+
+    int hit = 0;
+    uint64_t start = SDL_GetTicksNS();
+
+    for (const auto &p : point) {
+        hit += grid.find(p, time).has_value();
+    }
+
+    uint64_t ns = std::max<uint64_t>(SDL_GetTicksNS() - start, 1);
+    double queries_per_sec = static_cast<double>(queries) * 1e9 / static_cast<double>(ns);
+
+    LOG("hit test: %d targets, %d queries, %d hits, %.0f queries/sec",
+        static_cast<int>(grid.target.size()),
+        queries,
+        hit,
+        queries_per_sec);
+
+    return queries_per_sec;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "geometry.hpp"
+#include "gl_helper.hpp"
+
+// Point in shape queries for picking, all in normalized units (see main.cpp).
+
+// A shape placed on the board, transformed the same way as draw_shape: rotation*outline*scale + trans
+struct HitTarget {
+    size_t id = 0;  // returned by HitGrid::find
+
+    std::span<const glm::vec2> outline;  // must outlive the HitGrid, e.g. Shape::outline
+    glm::vec2 trans{};
+    float scale = 1.0f;
+    const ShapeRotation *rotation = nullptr;  // must outlive the HitGrid, e.g. &Shape::rotation, none is theta 0
+    float margin = 0.0f;  // extra reach past the outline in shape units, e.g. half the line thickness
+};
+
+// Winding number test of p against the outline rotated by theta, or within margin of one of its edges
+bool hit_test(const HitTarget &target, const glm::vec2 &p, float theta);
+
+// Uniform grid over an area, each cell lists the targets whose bounding circle overlaps it.
+// The bounding circle doesn't depend on theta, so targets can keep rotating without a rebuild.
+// Only trans, scale, margin or the outline changing need one.
+// find() works out the rotation of just the few targets near the point.
+struct HitGrid {
+    std::vector<HitTarget> target;
+
+    // Pick cell_size around the target size, then each query only looks at a handful of targets
+    void build(const BBox &area, float cell_size, std::vector<HitTarget> new_target);
+
+    // id of the first target hit in the order they were given to build(), time is ViewUniform::time
+    std::optional<size_t> find(const glm::vec2 &p, float time) const;
+
+    // set by build()
+    glm::vec2 origin{};
+    float inv_cell_size = 1.0f;
+    int cols = 0;
+    int rows = 0;
+
+    std::vector<float> bound_radius;  // per target
+
+    // target indices of cell c are cell_target[cell_start[c] .. cell_start[c + 1]]
+    std::vector<uint32_t> cell_start;
+    std::vector<uint32_t> cell_target;
+
+    // clamped to the grid, points outside the area land in the border cells
+    int cell_x(float x) const;
+    int cell_y(float y) const;
+};
+
+// Queries per second of grid.find at random points over area, for the benchmark
+double benchmark_hit_grid(const HitGrid &grid, const BBox &area, int queries, float time);
@@ -0,0 +1,117 @@
+#include "latency.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+void LatencyStats::add(float ms) {
+    size_t bucket = static_cast<size_t>(std::max(ms, 0.f) / LATENCY_BUCKET_MS);
+
+    histogram[std::min(bucket, LATENCY_BUCKETS - 1)]++;
+    samples++;
+    sum_ms += static_cast<double>(ms);
+    max_ms = std::max(max_ms, ms);
+}
+
+float LatencyStats::mean_ms() const {
+    if (samples == 0) {
+        return 0.f;
+    }
+
+    return static_cast<float>(sum_ms / static_cast<double>(samples));
+}
+
+float LatencyStats::percentile_ms(float p) const {
+    if (samples == 0) {
+        return 0.f;
+    }
+
+    uint64_t target = static_cast<uint64_t>(std::ceil(p * static_cast<float>(samples)));
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < LATENCY_BUCKETS - 1; i++) {
+        count += histogram[i];
+
+        if (count >= target) {
+            return std::min(static_cast<float>(i + 1) * LATENCY_BUCKET_MS, max_ms);
+        }
+    }
+
+    return max_ms;
+}
+
+std::string LatencyStats::json() const {
+    std::ostringstream ss;
+
+    ss << "{\"samples\": " << samples << ", \"dropped\": " << dropped << ", \"mean\": " << mean_ms()
+       << ", \"p50\": " << percentile_ms(0.5f) << ", \"p95\": " << percentile_ms(0.95f)
+       << ", \"p99\": " << percentile_ms(0.99f) << ", \"max\": " << max_ms << ", \"bucket_ms\": " << LATENCY_BUCKET_MS
+       << ", \"histogram\": [";
+
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        ss << (i > 0 ? ", " : "") << histogram[i];
+    }
+
+    ss << "]}";
+
+    return ss.str();
+}
+
+std::vector<std::string> LatencyStats::text() const {
+    constexpr size_t max_bar = 40;
+
+    std::vector<std::string> ret;
+    char buf[128];
+
+    snprintf(buf,
+             sizeof(buf),
+             "input latency: %d samples, p50 %.0f p95 %.0f max %.1f ms",
+             static_cast<int>(samples),
+             static_cast<double>(percentile_ms(0.5f)),
+             static_cast<double>(percentile_ms(0.95f)),
+             static_cast<double>(max_ms));
+    ret.push_back(buf);
+
+    uint32_t peak = std::max(*std::max_element(histogram.begin(), histogram.end()), 1u);
+
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        int lo = static_cast<int>(static_cast<float>(i) * LATENCY_BUCKET_MS);
+
+        if (i == LATENCY_BUCKETS - 1) {
+            snprintf(buf, sizeof(buf), "%3d+   ", lo);
+        } else {
+            snprintf(buf, sizeof(buf), "%3d-%-3d", lo, static_cast<int>(static_cast<float>(i + 1) * LATENCY_BUCKET_MS));
+        }
+
+        size_t bar = histogram[i] * max_bar / peak;
+        ret.push_back(std::string(buf) + " " + std::string(bar, '#') + " " + std::to_string(histogram[i]));
+    }
+
+    return ret;
+}
+
+void LatencyTracker::add_input(uint64_t timestamp_ns) {
+    if (num_pending == pending.size()) {
+        stats.dropped++;
+        return;
+    }
+
+    pending[num_pending++] = timestamp_ns;
+}
+
+void LatencyTracker::begin_frame() {
+    std::copy_n(pending.begin(), num_pending, frame.begin());
+    num_frame = num_pending;
+    num_pending = 0;
+}
+
+void LatencyTracker::end_frame(uint64_t now_ns) {
+    for (size_t i = 0; i < num_frame; i++) {
+        // timestamps can be a little ahead of SDL_GetTicksNS on some platforms
+        uint64_t ns = now_ns > frame[i] ? now_ns - frame[i] : 0;
+        stats.add(static_cast<float>(ns) * 1e-6f);
+    }
+
+    num_frame = 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Input to photon latency: from an input event's SDL timestamp to just after the swap of the first frame drawn
+// after the event was handled. With the GPU wait on it's to when the frame finished rendering instead.
+// It doesn't include the display scan out, which needs a camera to measure.
+
+constexpr size_t LATENCY_BUCKETS = 16;
+constexpr float LATENCY_BUCKET_MS = 5.0f;  // the last bucket also counts everything above it
+
+struct LatencyStats {
+    std::array<uint32_t, LATENCY_BUCKETS> histogram{};
+    uint64_t samples = 0;
+    double sum_ms = 0;
+    float max_ms = 0;
+    uint64_t dropped = 0;  // inputs that didn't fit in LatencyTracker::pending
+
+    void add(float ms);
+
+    float mean_ms() const;
+    float percentile_ms(float p) const;  // upper edge of the bucket it falls in, p in [0, 1]
+
+    // {"samples": ..., "mean": ..., "p50": ..., "p95": ..., "p99": ..., "max": ..., "bucket_ms": ..., "histogram": [...]}
+    std::string json() const;
+
+    // Summary line then one text bar per bucket, for drawing on screen
+    std::vector<std::string> text() const;
+};
+
+struct LatencyTracker {
+    static constexpr size_t MAX_PENDING = 256;
+
+    // timestamps of inputs handled since the last begin_frame
+    std::array<uint64_t, MAX_PENDING> pending{};
+    size_t num_pending = 0;
+
+    // inputs the frame being drawn reflects
+    std::array<uint64_t, MAX_PENDING> frame{};
+    size_t num_frame = 0;
+
+    LatencyStats stats;
+
+    void add_input(uint64_t timestamp_ns);  // SDL_Event::common.timestamp
+    void begin_frame();                      // before the frame reads any input state
+    void end_frame(uint64_t now_ns);         // just after SDL_GL_SwapWindow
+};
@@ -0,0 +1,112 @@
+#include "layer_cache.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "log.hpp"
+
+namespace {
+const char *vertex_shader = R"(#version 300 es
+precision mediump float;
+
+layout(location = 0) in vec2 pos; // clip space
+layout(location = 1) in vec2 uv;
+out vec2 frag_uv;
+
+void main() {
+    gl_Position = vec4(pos, 0.0, 1.0);
+    frag_uv = uv;
+})";
+
+const char *fragment_shader = R"(#version 300 es
+precision mediump float;
+
+uniform sampler2D tex;
+in vec2 frag_uv;
+out vec4 frag_color;
+
+void main() {
+    // the layer is opaque, alpha in the texture is whatever blending left there
+    frag_color = vec4(texture(tex, frag_uv).rgb, 1.0);
+})";
+}  // namespace
+
+bool LayerCache::init() {
+    shader = make_shader(vertex_shader, fragment_shader);
+
+    if (!shader) {
+        return false;
+    }
+
+    // pos + texture uv
+    std::vector<glm::vec4> vertex{
+        {-1.f, -1.f, 0.f, 0.f}, {1.f, -1.f, 1.f, 0.f}, {1.f, 1.f, 1.f, 1.f}, {-1.f, 1.f, 0.f, 1.f}};
+    quad = make_vertex_buffer(vertex, {0, 1, 2, 0, 2, 3});
+
+    return true;
+}
+
+bool LayerCache::finish() {
+    if (!shader->finish()) {
+        return false;
+    }
+
+    shader->use();
+    glUniform1i(shader->get_loc("tex"), 0);
+
+    return true;
+}
+
+void LayerCache::resize(int width_, int height_, int samples_) {
+    valid = false;
+
+    // init_game goes through resize_event every round
+    if (width_ == width && height_ == height && samples_ == samples) {
+        return;
+    }
+
+    width = width_;
+    height = height_;
+    samples = samples_;
+
+    // made on the next begin(), a drag resize would otherwise make one per event
+    target.reset();
+}
+
+bool LayerCache::begin() {
+    if (!enabled || valid) {
+        return false;
+    }
+
+    if (!target) {
+        target = make_render_target(width, height, samples);
+
+        if (!target) {
+            LOG("layer cache disabled");
+            enabled = false;
+            return false;
+        }
+    }
+
+    target->bind();
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    return true;
+}
+
+void LayerCache::end() {
+    target->resolve();
+    bind_default_framebuffer(width, height);
+
+    valid = true;
+    rebuilds++;
+}
+
+void LayerCache::draw() const {
+    if (!enabled || !valid) {
+        return;
+    }
+
+    draw_vertex_buffer(shader, quad, target->texture);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gl_helper.hpp"
+
+// Parts of the frame that only change on resize, score change or a new round, rendered into a window sized texture
+// when invalidated and composited with one textured quad each frame.
+struct LayerCache {
+    bool enabled = true;  // off draws the layer straight to the window every frame, for comparing
+    bool valid = false;
+
+    ShaderPtr shader{{}, {}};
+    VertexBufferPtr quad{{}, {}};
+    RenderTargetPtr target{{}, {}};
+
+    int width = 0;  // window pixels
+    int height = 0;
+    int samples = 0;  // of the window, the cache should look the same as drawing straight to it
+
+    uint64_t rebuilds = 0;  // for profiling
+
+    bool init();    // starts compiling the shader
+    bool finish();  // waits for it, call before drawing
+
+    // Call on window resize, invalidates and drops the texture if the size changed
+    void resize(int width_, int height_, int samples_);
+
+    void invalidate() { valid = false; }
+
+    // Returns true if the layer has to be drawn now, the cache is then bound and cleared.
+    // Call end() after drawing it.
+    bool begin();
+    void end();
+
+    void draw() const;  // the cached layer over the whole window
+};
@@ -20,14 +20,24 @@
 #include <map>
 #include <optional>
 #include <random>
+#include <string_view>
 #include <vector>
 
 #include "audio.hpp"
+#include "benchmark.hpp"
 #include "color_palette.hpp"
+#include "dynamic_resolution.hpp"
 #include "font.hpp"
+#include "frame_pacer.hpp"
+#include "frame_scheduler.hpp"
 #include "geometry.hpp"
 #include "gl_helper.hpp"
+#include "hit_test.hpp"
+#include "latency.hpp"
+#include "layer_cache.hpp"
 #include "log.hpp"
+#include "mesh_optimize.hpp"
+#include "view.hpp"
 
 // All co-ordinates used are normalized as follows
 // x: [0.0, 1.0]
@@ -44,7 +54,34 @@ const glm::vec4 BG_COLOR = Color::darkgrey;
 
 constexpr float SHAPE_ROTATION_SPEED = static_cast<float>(M_PI_2);
 constexpr float SHAPE_RADIUS = (1.f / NUM_SHAPES) * 0.4f;
+
+// The board is simulated in fixed steps, independent of the frame rate
+constexpr uint64_t SIM_STEP_NS = 1'000'000'000 / 120;
+constexpr int SIM_MAX_STEPS = 12;  // per frame, time beyond that is dropped after a stall
+
+// The View time restarts from 0 every 10 minutes, float seconds get too coarse for the rotation as uptime grows
+constexpr uint64_t TIME_EPOCH_TICKS = 600'000'000'000 / SIM_STEP_NS;
+
+// Uniform slots of ShapeShader, a shape keeps its own src and dst slots so the data only changes when it moves
+constexpr size_t BG_INSTANCE = 0;
+constexpr size_t NUM_SHAPE_INSTANCE = 1 + NUM_SHAPES * 2;
+constexpr size_t src_instance(size_t shape_idx) { return 1 + shape_idx * 2; }
+constexpr size_t dst_instance(size_t shape_idx) { return 2 + shape_idx * 2; }
 const glm::vec4 SHAPE_LINE_COLOR = Color::white;
+constexpr ShapeRenderer SHAPE_RENDERER = ShapeRenderer::MESH;  // SDF doesn't need MSAA, toggle with S
+constexpr bool SHAPE_MSAA = false;  // without MSAA the meshes get an antialiasing fringe instead, see make_fill
+constexpr bool SHAPE_SHORT_VERTEX = true;  // see ShapeMeshFormat
+constexpr PacingMode FRAME_PACING = PacingMode::VSYNC;  // cycle with V
+constexpr size_t MAX_POINTER = 11;  // the mouse and up to 10 fingers dragging at once
+constexpr size_t MOUSE_POINTER = 0;
+// Dragged shapes are drawn where the pointer is expected to be when the frame is shown
+constexpr bool DRAG_PREDICT = true;
+constexpr float DRAG_VELOCITY_SMOOTHING = 0.5f;         // weight of the newest motion event
+constexpr float DRAG_PREDICT_MAX_S = 1.f / 30.f;       // don't extrapolate further than this
+constexpr uint64_t DRAG_PREDICT_IDLE_NS = 50'000'000;  // pointer stopped if there's no motion for this long
+constexpr float HIT_GRID_CELL_SIZE = SHAPE_RADIUS * 2;
+constexpr int BENCHMARK_HIT_TEST_QUERIES = 1000000;
+constexpr int BENCHMARK_HIT_TEST_GRID = 8;  // 8x8 shapes, to see how picking scales with a bigger board
 
 const glm::vec4 FONT_FG = Color::yellow;
 const glm::vec4 FONT_BG = Color::transparent;
@@ -52,6 +89,12 @@ const glm::vec4 FONT_OUTLINE = Color::white;
 constexpr float FONT_OUTLINE_FACTOR = 0.1f;
 constexpr float FONT_WIDTH = 0.2f;
 
+const TextStyle SCORE_TEXT_STYLE{FONT_WIDTH, FONT_FG, FONT_BG, FONT_OUTLINE, FONT_OUTLINE_FACTOR};
+
+// debug overlays, e.g. the latency histogram toggled with L
+constexpr float OVERLAY_FONT_WIDTH = 0.025f;
+const TextStyle OVERLAY_TEXT_STYLE{OVERLAY_FONT_WIDTH, Color::white, FONT_BG, FONT_BG, 0.0f};
+
 std::vector<glm::vec4> shape_color_palette() {
     return {
         Color::blue,
@@ -69,10 +112,35 @@ std::vector<glm::vec4> shape_color_palette() {
 
 enum class AudioEnum { BGM, CORRECT, WIN };
 
+// Board clock advanced by simulate() in fixed SIM_STEP_NS ticks, rendering interpolates into the next one.
+// The shape rotation is a function of it, see ShapeRotation, so there is nothing else to step.
+struct SimState {
+    uint64_t tick = 0;
+};
+
+// The mouse or one finger on the touch screen, each drags its own shape
+struct Pointer {
+    bool active = false;  // finger is down, the mouse is always active
+    SDL_TouchID touch = 0;
+    SDL_FingerID finger = 0;
+
+    // Latest position from the events, screen pixels.
+    // Motion events only store it, the hit test runs once a frame in SDL_AppIterate.
+    glm::vec2 pos{};
+    bool moved = false;
+
+    glm::vec2 velocity{};         // screen pixels per second, smoothed over the motion events
+    uint64_t last_motion_ns = 0;  // SDL event timestamp
+
+    std::optional<size_t> selected_shape;
+    std::optional<size_t> highlight_dst;
+};
+
 struct AppState {
     SDL_Window *window = nullptr;
     SDL_Renderer *renderer = nullptr;
     SDL_GLContext gl_ctx;
+    std::string pref_path;
 
     SDL_AudioDeviceID audio_device = 0;
     std::map<AudioEnum, Audio> audio;
@@ -82,13 +150,21 @@ struct AppState {
 
     FontAtlas font;
     FontShader font_shader;
+    TextBatch text_batch;
+    std::string score_text;
+
+    LayerCache layer_cache;  // background, score and placed shapes
+    ShapeQueue shape_queue;  // everything else on the board, drawn sorted once it's all queued
+    DynamicResolution dynres;
+
+    Arena shape_storage{SHAPE_STORAGE_BYTES};  // has to outlive draw_area_bg and shape_set, see make_shape_set
+    size_t shape_set_allocations = 0;          // heap allocations made by make_shape_set, for profiling
 
     // drawing area within the window
     Shape draw_area_bg;
 
     VertexArrayPtr vao{{}, {}};
-    VertexBufferPtr score_vertex{{}, {}};
-    BBox score_vertex_bbox;
+    View view;
 
     ShapeShader shape_shader;
 
@@ -98,10 +174,27 @@ struct AppState {
     std::array<glm::vec2, NUM_SHAPES> src_center;  // position for src shape, normalized units
     std::array<glm::vec2, NUM_SHAPES> dst_center;  // position for dst shape, normalized units
     std::array<bool, NUM_SHAPES> shape_done;
-    std::optional<size_t> selected_shape;
-    std::optional<size_t> highlight_dst;
+    // src_hit has the shapes not done yet, dst_hit all the dst outlines in shape order
+    HitGrid src_hit;
+    HitGrid dst_hit;
+
+    std::array<Pointer, MAX_POINTER> pointer;  // pointer[MOUSE_POINTER] is the mouse, the rest are fingers
+    uint64_t coalesced_motion = 0;  // motion events superseded by a later one in the same frame, for profiling
+
+    FrameScheduler scheduler;
+    FramePacer pacer;
+    LatencyTracker latency;
+    bool show_latency = false;
+    bool latency_gpu_wait = false;  // glFinish after the swap, so the latency includes the GPU finishing the frame
 
     uint64_t last_tick = 0;
+
+    SimState sim;
+    uint64_t sim_accumulator_ns = 0;
+    uint64_t time_epoch_tick = 0;  // the View time counts from here, see rebase_time
+
+    bool msaa = SHAPE_MSAA;
+    Benchmark benchmark;
 };
 
 bool resize_event(AppState &as) {
@@ -136,18 +229,76 @@ bool resize_event(AppState &as) {
     auto norm_y = [=](float y) { return (y - draw_area_offset.y) / draw_area_size.x; };
 
     glViewport(0, 0, win_w, win_h);
+
+    GLint samples = 0;
+    glGetIntegerv(GL_SAMPLES, &samples);
+    as.layer_cache.resize(win_w, win_h, samples);
+    as.dynres.resize(win_w, win_h, samples);
+
     glm::mat4 ortho = glm::ortho(norm_x(0.f), norm_x(win_wf), norm_y(win_hf), norm_y(0.f));
 
-    as.shape_shader.set_ortho(ortho);
-    as.shape_shader.draw_area_offset = draw_area_offset;
-    as.shape_shader.draw_area_size = draw_area_size;
+    as.view.uniform.ortho = ortho;
+    as.view.uniform.draw_area_offset = draw_area_offset;
+    as.view.uniform.draw_area_size = draw_area_size;
+    as.view.uniform.display_width = draw_area_size.x;
+    as.view.update();
 
-    as.font_shader.set_ortho(ortho);
-    as.font_shader.set_display_width(draw_area_size.x);
+    for (auto &s : as.shape_set) {
+        select_lod(s, s.scale * draw_area_size.x);
+    }
 
     return true;
 }
 
+BBox draw_area() { return BBox{{0.f, 0.f}, {1.f, NORM_HEIGHT}}; }
+
+HitTarget make_hit_target(const Shape &shape, size_t id, const glm::vec2 &trans) {
+    HitTarget t;
+    t.id = id;
+    t.outline = shape.outline;
+    t.trans = trans;
+    t.scale = shape.scale;
+    t.rotation = &shape.rotation;
+    t.margin = shape.line_thickness * 0.5f;  // the outline is drawn centered on the edge
+
+    return t;
+}
+
+// Call when the shapes move to a different place, the targets follow the shapes' rotation on their own
+void update_hit_grid(AppState &as) {
+    std::vector<HitTarget> src;
+    std::vector<HitTarget> dst;
+
+    for (size_t i = 0; i < NUM_SHAPES; i++) {
+        const Shape &s = *as.shape[i];
+        size_t dst_idx = as.shape_src_to_dst_idx[i];
+
+        if (!as.shape_done[i]) {
+            src.push_back(make_hit_target(s, i, as.src_center[i]));
+        }
+
+        dst.push_back(make_hit_target(s, dst_idx, as.dst_center[dst_idx]));
+    }
+
+    as.src_hit.build(draw_area(), HIT_GRID_CELL_SIZE, std::move(src));
+    as.dst_hit.build(draw_area(), HIT_GRID_CELL_SIZE, std::move(dst));
+}
+
+// Spins from where it is now, in the shape's rotation_direction
+void start_rotation(const AppState &as, Shape &shape) {
+    float now = as.view.uniform.time;
+    float theta = std::fmod(shape.rotation.at(now), static_cast<float>(2 * M_PI));
+
+    shape.rotation = ShapeRotation{theta, SHAPE_ROTATION_SPEED * shape.rotation_direction, now};
+}
+
+void stop_rotation(const AppState &as, Shape &shape) {
+    float now = as.view.uniform.time;
+    float theta = std::fmod(shape.rotation.at(now), static_cast<float>(2 * M_PI));
+
+    shape.rotation = ShapeRotation{theta, 0.0f, now};
+}
+
 void init_game(AppState &as) {
     std::random_device rd;
     std::mt19937 g(rd());
@@ -167,6 +318,8 @@ void init_game(AppState &as) {
             s->rotation_direction = -1;
         }
 
+        start_rotation(as, *s);
+
         i++;
     }
 
@@ -177,9 +330,13 @@ void init_game(AppState &as) {
         b = false;
     }
 
-    as.selected_shape.reset();
-    as.highlight_dst.reset();
+    for (auto &p : as.pointer) {
+        p.selected_shape.reset();
+        p.highlight_dst.reset();
+    }
 
+    as.layer_cache.invalidate();
+    update_hit_grid(as);
     resize_event(as);
 }
 
@@ -216,65 +373,232 @@ bool init_font(AppState &as, const std::string &base_path) {
         return false;
     }
 
-    if (!as.font_shader.init(as.font)) {
-        return false;
+    as.text_batch.init();
+
+    return true;
+}
+
+void update_score_text(AppState &as) {
+    as.score_text = std::to_string(as.score);
+    as.layer_cache.invalidate();
+}
+
+void simulate(AppState &as) { as.sim.tick++; }
+
+// Runs the simulation up to now, returns how far now is into the next step in [0, 1)
+float advance_simulation(AppState &as, uint64_t elapsed_ns) {
+    as.sim_accumulator_ns += elapsed_ns;
+
+    for (int step = 0; as.sim_accumulator_ns >= SIM_STEP_NS; step++) {
+        if (step == SIM_MAX_STEPS) {
+            as.sim_accumulator_ns %= SIM_STEP_NS;
+            break;
+        }
+
+        simulate(as);
+        as.sim_accumulator_ns -= SIM_STEP_NS;
     }
 
-    as.font_shader.set_font_distance_range(static_cast<float>(as.font.distance_range));
-    as.font_shader.set_font_grid_width(static_cast<float>(as.font.grid_width));
-    as.font_shader.set_font_width(FONT_WIDTH);
+    return static_cast<float>(as.sim_accumulator_ns) / static_cast<float>(SIM_STEP_NS);
+}
 
-    as.font_shader.set_fg(FONT_FG);
-    as.font_shader.set_bg(FONT_BG);
-    as.font_shader.set_outline(FONT_OUTLINE);
-    as.font_shader.set_outline_factor(FONT_OUTLINE_FACTOR);
+// Seconds on the simulation clock since time_epoch_tick, alpha is how far into the next step
+float sim_time(const AppState &as, float alpha) {
+    double ticks = static_cast<double>(as.sim.tick - as.time_epoch_tick) + static_cast<double>(alpha);
+    return static_cast<float>(ticks * static_cast<double>(SIM_STEP_NS) * 1e-9);
+}
 
-    return true;
+// Moves the View time epoch to the current tick and rewrites the rotations against it.
+// The shapes don't move, only the numbers the shaders get become small again.
+void rebase_time(AppState &as, float alpha) {
+    float old_now = sim_time(as, alpha);
+    as.time_epoch_tick = as.sim.tick;
+    float new_now = sim_time(as, alpha);
+
+    for (auto &s : as.shape_set) {
+        const ShapeRotation &r = s.rotation;
+        float theta = std::fmod(r.at(old_now), static_cast<float>(2 * M_PI));
+
+        s.rotation = ShapeRotation{theta, r.omega, new_now};
+    }
 }
 
-void update_score_text(AppState &as) {
-    auto [vertex, index] = as.font.make_text_vertex(std::to_string(as.score), true);
-    as.score_vertex_bbox = bbox(vertex);
-    as.score_vertex->update_vertex(
-        glm::value_ptr(vertex[0]), sizeof(decltype(vertex)::value_type) * vertex.size(), index);
+// Returns the src shape index or the dst position index under pos, in screen pixels
+std::optional<size_t> find_selected_shape(const AppState &as, bool dst, const glm::vec2 &pos) {
+    const HitGrid &grid = dst ? as.dst_hit : as.src_hit;
+
+    return grid.find(screen_pos_to_normalize_pos(as.view, pos), as.view.uniform.time);
 }
 
-std::optional<size_t> find_selected_shape(const AppState &as, bool dst) {
-    float cx, cy;
-    SDL_GetMouseState(&cx, &cy);
+bool is_dragging(const Pointer &p) { return p.active && p.selected_shape; }
 
-    std::optional<size_t> selected_shape;
+// Pointer holding the shape, if any
+const Pointer *shape_pointer(const AppState &as, size_t shape) {
+    for (const auto &p : as.pointer) {
+        if (p.active && p.selected_shape == shape) {
+            return &p;
+        }
+    }
 
-    glm::vec2 shape_radius{SHAPE_RADIUS, SHAPE_RADIUS};
+    return nullptr;
+}
 
-    for (size_t i = 0; i < NUM_SHAPES; i++) {
-        glm::vec2 center;
+// Slot for a finger, a free one is taken if add is true. nullptr once all the slots are in use.
+Pointer *find_finger_pointer(AppState &as, const SDL_TouchFingerEvent &e, bool add) {
+    Pointer *free_slot = nullptr;
 
-        if (dst) {
-            center = as.dst_center[i];
-        } else {
-            if (as.shape_done[i]) {
-                continue;
-            }
-            center = as.src_center[i];
+    for (size_t i = MOUSE_POINTER + 1; i < MAX_POINTER; i++) {
+        Pointer &p = as.pointer[i];
+
+        if (p.active && p.touch == e.touchID && p.finger == e.fingerID) {
+            return &p;
         }
 
-        glm::vec2 start = normalize_pos_to_screen_pos(as.shape_shader, center - shape_radius);
-        glm::vec2 end = normalize_pos_to_screen_pos(as.shape_shader, center + shape_radius);
+        if (!p.active && !free_slot) {
+            free_slot = &p;
+        }
+    }
 
-        if ((cx > start.x) && (cx < end.x) && (cy > start.y) && (cy < end.y)) {
-            selected_shape = i;
-            break;
+    if (!add || !free_slot) {
+        return nullptr;
+    }
+
+    free_slot->active = true;
+    free_slot->touch = e.touchID;
+    free_slot->finger = e.fingerID;
+
+    return free_slot;
+}
+
+// finger positions are normalized to the window
+glm::vec2 finger_pos(const AppState &as, const SDL_TouchFingerEvent &e) {
+    int win_w = 0, win_h = 0;
+    SDL_GetWindowSize(as.window, &win_w, &win_h);
+
+    return glm::vec2{e.x * static_cast<float>(win_w), e.y * static_cast<float>(win_h)};
+}
+
+// The pointer read straight from SDL rather than the last event handled, plus how far it's expected to move in
+// predict_s seconds. Call just before drawing what follows it.
+glm::vec2 latch_pointer_pos(const AppState &as, const Pointer &p, float predict_s) {
+    glm::vec2 pos = p.pos;
+
+    // Only the mouse is re-polled, SDL_GetMouseState is a plain read. SDL_GetTouchFingers allocates the list on
+    // every call, and the touch pointers already have the last FINGER_MOTION pumped before this frame.
+    if (&p == &as.pointer[MOUSE_POINTER]) {
+        SDL_GetMouseState(&pos.x, &pos.y);
+    }
+
+    if (DRAG_PREDICT && SDL_GetTicksNS() - p.last_motion_ns < DRAG_PREDICT_IDLE_NS) {
+        pos += p.velocity * std::min(predict_s, DRAG_PREDICT_MAX_S);
+    }
+
+    return pos;
+}
+
+void pointer_down(AppState &as, Pointer &p, const glm::vec2 &pos) {
+    p.pos = pos;
+    p.moved = false;
+    p.velocity = glm::vec2{};
+    p.last_motion_ns = 0;
+    p.selected_shape.reset();
+    p.highlight_dst.reset();
+
+    std::optional<size_t> shape = find_selected_shape(as, false, pos);
+
+    // someone else is already dragging it
+    if (shape && shape_pointer(as, *shape)) {
+        return;
+    }
+
+    p.selected_shape = shape;
+}
+
+void pointer_motion(AppState &as, Pointer &p, const glm::vec2 &pos, uint64_t timestamp_ns) {
+    if (p.moved) {
+        as.coalesced_motion++;
+    }
+
+    if (p.last_motion_ns > 0 && timestamp_ns > p.last_motion_ns) {
+        float dt = static_cast<float>(timestamp_ns - p.last_motion_ns) * 1e-9f;
+        p.velocity = glm::mix(p.velocity, (pos - p.pos) / dt, DRAG_VELOCITY_SMOOTHING);
+    }
+
+    p.last_motion_ns = timestamp_ns;
+
+    p.pos = pos;
+    p.moved = true;
+}
+
+// Drops the selected shape at pos, cancel puts it back without scoring
+void pointer_up(AppState &as, Pointer &p, const glm::vec2 &pos, bool cancel) {
+    p.pos = pos;
+    p.moved = false;
+    p.highlight_dst.reset();
+
+    std::optional<size_t> selected_shape = p.selected_shape;
+    p.selected_shape.reset();
+
+    if (!selected_shape || cancel) {
+        return;
+    }
+
+    std::optional<size_t> dst_idx = find_selected_shape(as, true, pos);
+
+    if (as.shape_src_to_dst_idx[*selected_shape] != dst_idx) {
+        return;
+    }
+
+    as.shape_done[*selected_shape] = true;
+    stop_rotation(as, *as.shape[*selected_shape]);
+    as.layer_cache.invalidate();
+    as.audio[AudioEnum::CORRECT].play();
+    update_hit_grid(as);
+
+    // check if we won
+    auto is_true = [](bool b) { return b; };
+    if (std::all_of(as.shape_done.begin(), as.shape_done.end(), is_true)) {
+        as.audio[AudioEnum::WIN].play();
+        as.score++;
+
+        if (as.score > MAX_SCORE) {
+            as.score = 1;
+        }
+
+        init_game(as);
+        update_score_text(as);
+    }
+}
+
+// Picking on a bigger board than the game uses, returns queries/sec
+double benchmark_hit_test(const AppState &as) {
+    constexpr auto num_target = static_cast<size_t>(BENCHMARK_HIT_TEST_GRID * BENCHMARK_HIT_TEST_GRID);
+
+    std::vector<HitTarget> target;
+    std::vector<ShapeRotation> rotation(num_target);  // all spinning, the same as the game at its worst
+    float spacing = 1.0f / BENCHMARK_HIT_TEST_GRID;
+
+    for (int y = 0; y < BENCHMARK_HIT_TEST_GRID; y++) {
+        for (int x = 0; x < BENCHMARK_HIT_TEST_GRID; x++) {
+            size_t i = target.size();
+            glm::vec2 center{(static_cast<float>(x) + 0.5f) * spacing,
+                             (static_cast<float>(y) + 0.5f) * spacing * NORM_HEIGHT};
+
+            HitTarget t = make_hit_target(as.shape_set[i % as.shape_set.size()], i, center);
+            t.scale = spacing * NORM_HEIGHT * 0.4f;
+            rotation[i] = ShapeRotation{static_cast<float>(i), SHAPE_ROTATION_SPEED, 0.0f};
+            t.rotation = &rotation[i];
+            target.push_back(t);
         }
     }
 
-    return selected_shape;
+    HitGrid grid;
+    grid.build(draw_area(), spacing * NORM_HEIGHT, std::move(target));
+
+    return benchmark_hit_grid(grid, draw_area(), BENCHMARK_HIT_TEST_QUERIES, as.view.uniform.time);
 }
-SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
-    // Unused
-    (void)argc;
-    (void)argv;
 
+SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
     if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
         LOG("SDL_Init failed: %s", SDL_GetError());
         return SDL_APP_FAILURE;
@@ -289,23 +613,45 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
 
     *appstate = as;
 
+    ShapeRenderer shape_renderer = SHAPE_RENDERER;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (arg == "--benchmark") {
+            as->benchmark.enabled = true;
+        } else if (arg == "--msaa") {
+            as->msaa = true;
+        } else if (arg == "--sdf") {
+            shape_renderer = ShapeRenderer::SDF;
+        } else if (arg == "--dynamic-resolution") {
+            as->dynres.enabled = true;
+        } else if (arg == "--no-layer-cache") {
+            as->layer_cache.enabled = false;
+        } else if (arg == "--latency-gpu-wait") {
+            as->latency_gpu_wait = true;
+        } else {
+            LOG("unknown option %s", argv[i]);
+        }
+    }
+
     std::string base_path = "assets/";
 #ifdef __ANDROID__
     base_path = "";
 #endif
 
-    if (!init_audio(*as, base_path)) {
-        return SDL_APP_FAILURE;
-    }
-
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
+    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, as->msaa ? 1 : 0);
 
     // Android
     SDL_SetHint(SDL_HINT_ORIENTATIONS, "LandscapeLeft LandscapeRight");
 
+    // fingers are handled directly, skip the emulated mouse
+    SDL_SetHint(SDL_HINT_TOUCH_MOUSE_EVENTS, "0");
+    as->pointer[MOUSE_POINTER].active = true;
+
     if (!SDL_CreateWindowAndRenderer("Shape Game",
                                      640,
                                      480,
@@ -316,50 +662,85 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
         return SDL_APP_FAILURE;
     }
 
-    if (!SDL_SetRenderVSync(as->renderer, 1)) {
-        LOG("SDL_SetRenderVSync failed");
-        return SDL_APP_FAILURE;
-    }
-
     SDL_SetWindowFullscreen(as->window, true);
 
 #ifndef __EMSCRIPTEN__
     as->gl_ctx = SDL_GL_CreateContext(as->window);
     SDL_GL_MakeCurrent(as->window, as->gl_ctx);
     enable_gl_debug_callback();
+
+    if (char *pref_path = SDL_GetPrefPath("nghiaho12", "shape_game")) {
+        as->pref_path = pref_path;
+        enable_program_binary_cache(pref_path);
+        SDL_free(pref_path);
+    }
+
 #endif
 
+    // falls back to the limiter if vsync doesn't work, not worth failing over
+    as->pacer.init(as->window, as->renderer, as->benchmark.enabled ? PacingMode::LIMITER : FRAME_PACING);
+
+    if (as->benchmark.enabled) {
+        // measure the frame time, not the display refresh rate
+        as->pacer.limit_hz = 0;
+    }
+
+    as->scheduler.enabled = !as->benchmark.enabled;
+
+    enable_parallel_shader_compile();
+    enable_primitive_restart();
+
+    // Queue the shader compiles first, the driver works on them while we decode the assets
+    if (!as->font_shader.init() || !as->shape_shader.init(NUM_SHAPE_INSTANCE) || !as->layer_cache.init() ||
+        !as->dynres.init()) {
+        return SDL_APP_FAILURE;
+    }
+
+    if (!init_audio(*as, base_path)) {
+        return SDL_APP_FAILURE;
+    }
+
+    as->audio[AudioEnum::BGM].loop();
+
     if (!init_font(*as, base_path)) {
         return SDL_APP_FAILURE;
     }
 
-    // pre-allocate all vertex we need
-    // number of space needs to be >= MAX_SCORE string
-    std::tie(as->score_vertex, std::ignore) = as->font.make_text("    ", true);
     update_score_text(*as);
 
-    if (!as->shape_shader.init()) {
+    as->vao = make_vertex_array();
+
+    if (!as->view.init()) {
         return SDL_APP_FAILURE;
     }
 
-    as->vao = make_vertex_array();
+    as->shape_shader.renderer = shape_renderer;
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // scratch for building the meshes, freed once they're uploaded
+    Arena arena(GEOMETRY_ARENA_BYTES);
+
     // background color for drawing area
     {
-        std::vector<glm::vec2> vertex{
+        std::array<glm::vec2, 4> vertex{{
             {0.f, 0.f},
             {1.f, 0.f},
             {1.f, NORM_HEIGHT},
             {0.f, NORM_HEIGHT},
-        };
+        }};
 
-        as->draw_area_bg = make_shape(vertex, 0, {}, BG_COLOR);
+        // edges are covered by the window border or black bars, no fringe needed
+        as->draw_area_bg = make_shape(arena, as->shape_storage, vertex, 0, {}, BG_COLOR);
     }
 
-    as->shape_set = make_shape_set(SHAPE_LINE_COLOR, shape_color_palette());
+    ShapeMeshFormat shape_format{!as->msaa, SHAPE_SHORT_VERTEX};
+    std::vector<glm::vec4> palette = shape_color_palette();
+    size_t allocations = heap_allocation_count();
+
+    as->shape_set = make_shape_set(arena, as->shape_storage, SHAPE_LINE_COLOR, std::move(palette), shape_format);
+    as->shape_set_allocations = heap_allocation_count() - allocations;
 
     for (auto &s : as->shape_set) {
         s.scale = SHAPE_RADIUS;
@@ -375,9 +756,15 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
         as->dst_center[i].y = NORM_HEIGHT * 3.f / 4.f;
     }
 
+    // shaders are first used from here on
+    if (!as->font_shader.finish(as->font) || !as->shape_shader.finish() || !as->layer_cache.finish() ||
+        !as->dynres.finish()) {
+        return SDL_APP_FAILURE;
+    }
+
     init_game(*as);
 
-    as->last_tick = SDL_GetTicks();
+    as->last_tick = SDL_GetTicksNS();
 
     return SDL_APP_CONTINUE;
 }
@@ -385,6 +772,12 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
 SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
     AppState &as = *static_cast<AppState *>(appstate);
 
+    as.scheduler.handle_event(*event);
+
+    if (is_input_event(*event)) {
+        as.latency.add_input(event->common.timestamp);
+    }
+
     switch (event->type) {
         case SDL_EVENT_QUIT:
             return SDL_APP_SUCCESS;
@@ -404,6 +797,28 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
                 }
             }
 
+            if (event->key.key == SDLK_V) {
+                as.pacer.next_mode();
+            }
+
+            if (event->key.key == SDLK_L) {
+                as.show_latency = !as.show_latency;
+            }
+
+            if (event->key.key == SDLK_R) {
+                as.dynres.set_enabled(!as.dynres.enabled);
+            }
+
+            if (event->key.key == SDLK_S) {
+                if (as.shape_shader.renderer == ShapeRenderer::MESH) {
+                    as.shape_shader.renderer = ShapeRenderer::SDF;
+                } else {
+                    as.shape_shader.renderer = ShapeRenderer::MESH;
+                }
+
+                as.layer_cache.invalidate();
+            }
+
             break;
 
         case SDL_EVENT_WINDOW_RESIZED:
@@ -411,46 +826,53 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
             break;
 
         case SDL_EVENT_MOUSE_BUTTON_DOWN:
-            as.selected_shape = find_selected_shape(as, false);
+            if (event->button.which != SDL_TOUCH_MOUSEID) {
+                pointer_down(as, as.pointer[MOUSE_POINTER], glm::vec2{event->button.x, event->button.y});
+            }
             break;
 
         case SDL_EVENT_MOUSE_MOTION:
-            as.highlight_dst.reset();
-
-            if (as.selected_shape) {
-                as.highlight_dst = find_selected_shape(as, true);
+            if (event->motion.which != SDL_TOUCH_MOUSEID) {
+                pointer_motion(as,
+                               as.pointer[MOUSE_POINTER],
+                               glm::vec2{event->motion.x, event->motion.y},
+                               event->motion.timestamp);
             }
             break;
 
         case SDL_EVENT_MOUSE_BUTTON_UP:
-            as.highlight_dst.reset();
-
-            if (as.selected_shape) {
-                std::optional<size_t> dst_idx = find_selected_shape(as, true);
-
-                if (as.shape_src_to_dst_idx[*as.selected_shape] == dst_idx) {
-                    as.shape_done[*as.selected_shape] = true;
-                    as.audio[AudioEnum::CORRECT].play();
-                }
+            if (event->button.which != SDL_TOUCH_MOUSEID) {
+                pointer_up(as, as.pointer[MOUSE_POINTER], glm::vec2{event->button.x, event->button.y}, false);
             }
+            break;
 
-            as.selected_shape.reset();
-
-            // check if we won
-            auto is_true = [](bool b) { return b; };
-            if (std::all_of(as.shape_done.begin(), as.shape_done.end(), is_true)) {
-                as.audio[AudioEnum::WIN].play();
-                as.score++;
+        case SDL_EVENT_FINGER_DOWN:
+            if (Pointer *p = find_finger_pointer(as, event->tfinger, true)) {
+                pointer_down(as, *p, finger_pos(as, event->tfinger));
+            }
+            break;
 
-                if (as.score > MAX_SCORE) {
-                    as.score = 1;
-                }
+        case SDL_EVENT_FINGER_MOTION:
+            if (Pointer *p = find_finger_pointer(as, event->tfinger, false)) {
+                pointer_motion(as, *p, finger_pos(as, event->tfinger), event->tfinger.timestamp);
+            }
+            break;
 
-                init_game(as);
-                update_score_text(as);
+        case SDL_EVENT_FINGER_UP:
+            if (Pointer *p = find_finger_pointer(as, event->tfinger, false)) {
+                pointer_up(as, *p, finger_pos(as, event->tfinger), false);
+                p->active = false;
             }
+            break;
 
+#if SDL_VERSION_ATLEAST(3, 2, 0)
+        case SDL_EVENT_FINGER_CANCELED:
+            if (Pointer *p = find_finger_pointer(as, event->tfinger, false)) {
+                pointer_up(as, *p, p->pos, true);
+                p->active = false;
+            }
             break;
+#endif
     }
 
     return SDL_APP_CONTINUE;
@@ -462,6 +884,8 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result) {
 
     if (appstate) {
         AppState &as = *static_cast<AppState *>(appstate);
+        LOG("coalesced %d pointer motion events", static_cast<int>(as.coalesced_motion));
+
         SDL_DestroyRenderer(as.renderer);
         SDL_DestroyWindow(as.window);
 
@@ -478,17 +902,44 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result) {
     }
 }
 
+// The parts of the frame that don't move, drawn through LayerCache.
+// Pending destination outlines spin with their shape so they're drawn every frame.
+void draw_static_layer(AppState &as) {
+    draw_shape(as.shape_shader, as.draw_area_bg, BG_INSTANCE, true, false, false);
+
+    if (as.score > 0) {
+        // draw the score in the middle of the drawing area
+        as.text_batch.add(
+            as.font, as.score_text, glm::vec2{0.5f, NORM_HEIGHT * 0.5f}, SCORE_TEXT_STYLE, TextAlign::CENTER);
+    }
+
+    as.text_batch.flush(as.font_shader, as.font);
+
+    for (size_t i = 0; i < as.shape.size(); i++) {
+        if (as.shape_done[i]) {
+            Shape &s = *as.shape[i];
+            s.trans = as.dst_center[as.shape_src_to_dst_idx[i]];
+            draw_shape(as.shape_shader, s, dst_instance(i), true, true, false);
+        }
+    }
+}
+
 SDL_AppResult SDL_AppIterate(void *appstate) {
     AppState &as = *static_cast<AppState *>(appstate);
 
-    float dt = static_cast<float>(SDL_GetTicksNS() - as.last_tick) * 1e-9f;
-    as.last_tick = SDL_GetTicksNS();
+    uint64_t now = SDL_GetTicksNS();
 
-    auto &bgm = as.audio[AudioEnum::BGM];
-    if (SDL_GetAudioStreamAvailable(bgm.stream) < static_cast<int>(bgm.data.size())) {
-        bgm.play();
+    // the board freezes while paused
+    if (!as.scheduler.update(now, std::any_of(as.pointer.begin(), as.pointer.end(), is_dragging))) {
+        as.last_tick = now;
+        as.dynres.update(0.0f, 0.0f, false);
+        return SDL_APP_CONTINUE;
     }
 
+    float dt = static_cast<float>(now - as.last_tick) * 1e-9f;
+    float alpha = advance_simulation(as, now - as.last_tick);
+    as.last_tick = now;
+
 #ifndef __EMSCRIPTEN__
     SDL_GL_MakeCurrent(as.window, as.gl_ctx);
 #endif
@@ -500,63 +951,166 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
         as.init = true;
     }
 
+    if (as.sim.tick - as.time_epoch_tick >= TIME_EPOCH_TICKS) {
+        rebase_time(as, alpha);
+    }
+
+    // the only per frame upload while nothing is being dragged, the shaders rotate the shapes from it
+    as.view.update_time(sim_time(as, alpha));
+
     // glDisable(GL_DEPTH_TEST);
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
 
     as.vao->use();
 
-    float cx = 0, cy = 0;
-    SDL_GetMouseState(&cx, &cy);
+    // input from here on shows up in this frame
+    as.latency.begin_frame();
 
-    draw_shape(as.shape_shader, as.draw_area_bg, true, false, false);
+    for (auto &p : as.pointer) {
+        if (p.moved) {
+            p.moved = false;
+            p.highlight_dst.reset();
 
-    if (as.score > 0) {
-        // draw the score in the middle of the drawing area
-        const BBox &bbox = as.score_vertex_bbox;
+            if (p.selected_shape) {
+                p.highlight_dst = find_selected_shape(as, true, p.pos);
+            }
+        }
+    }
 
-        glm::vec2 text_center = (bbox.start + bbox.end) * 0.5f * FONT_WIDTH;
-        glm::vec2 trans = glm::vec2{0.5f, NORM_HEIGHT * 0.5f} - text_center;
+    if (as.layer_cache.begin()) {
+        draw_static_layer(as);
+        as.layer_cache.end();
+    }
 
-        as.font_shader.set_trans(trans);
-        draw_vertex_buffer(as.font_shader.shader, as.score_vertex, as.font.tex);
+    if (as.layer_cache.enabled) {
+        as.layer_cache.draw();
+    } else {
+        draw_static_layer(as);
     }
 
     for (size_t i = 0; i < as.shape.size(); i++) {
         auto &s = *as.shape[i];
         size_t dst_idx = as.shape_src_to_dst_idx[i];
 
-        if (as.shape_done[i]) {
-            s.trans = as.dst_center[dst_idx];
-            draw_shape(as.shape_shader, s, true, true, false);
-        } else {
-            if (i == as.selected_shape) {
-                glm::vec2 pos = screen_pos_to_normalize_pos(as.shape_shader, glm::vec2{cx, cy});
-                s.trans = pos;
-            } else {
+        // placed shapes are in the static layer
+        if (!as.shape_done[i]) {
+            // dragged shapes are drawn last, see below
+            if (!shape_pointer(as, i)) {
                 s.trans = as.src_center[i];
+                queue_shape(as.shape_queue, as.shape_shader, s, src_instance(i), false, true, true, false);
             }
 
-            s.theta += SHAPE_ROTATION_SPEED * s.rotation_direction * dt;
-            if (s.theta < 0) {
-                s.theta = static_cast<float>(2 * M_PI);
-            } else if (s.theta > 2 * M_PI) {
-                s.theta = 0.f;
-            }
-
-            draw_shape(as.shape_shader, s, true, true, false);
-
             // destination shape
             s.trans = as.dst_center[dst_idx];
-            if (as.highlight_dst == dst_idx) {
-                draw_shape(as.shape_shader, s, false, false, true);
+            auto is_highlight = [&](const Pointer &p) { return p.active && p.highlight_dst == dst_idx; };
+
+            if (std::any_of(as.pointer.begin(), as.pointer.end(), is_highlight)) {
+                queue_shape(as.shape_queue, as.shape_shader, s, dst_instance(i), false, false, false, true);
             } else {
-                draw_shape(as.shape_shader, s, false, true, false);
+                queue_shape(as.shape_queue, as.shape_shader, s, dst_instance(i), false, false, true, false);
+            }
+        }
+    }
+
+    // Dragged shapes go on top, with the pointer read as late as possible.
+    // The frame is shown about one frame time from now, so that's how far ahead to predict.
+    if (std::any_of(as.pointer.begin(), as.pointer.end(), is_dragging)) {
+        SDL_PumpEvents();
+
+        for (const auto &p : as.pointer) {
+            if (is_dragging(p)) {
+                Shape &s = *as.shape[*p.selected_shape];
+                s.trans = screen_pos_to_normalize_pos(as.view, latch_pointer_pos(as, p, dt));
+                queue_shape(as.shape_queue,
+                            as.shape_shader,
+                            s,
+                            src_instance(*p.selected_shape),
+                            true,
+                            true,
+                            true,
+                            false);
             }
         }
     }
 
+    // The moving shapes are where the fill rate goes, they're drawn at a lower resolution when frames run long.
+    // The antialiasing fringe is a pixel wide, so it follows the resolution.
+    float display_width = as.view.uniform.display_width;
+    float scaled_display_width = as.dynres.begin(display_width);
+
+    if (scaled_display_width != display_width) {
+        as.view.uniform.display_width = scaled_display_width;
+        as.view.update();
+    }
+
+    draw_shape_queue(as.shape_shader, as.shape_queue);
+    as.dynres.end();
+
+    if (scaled_display_width != display_width) {
+        as.view.uniform.display_width = display_width;
+        as.view.update();
+    }
+
+    if (as.show_latency) {
+        std::vector<std::string> lines = as.latency.stats.text();
+        lines.insert(lines.begin(), as.dynres.text());
+        lines.insert(lines.begin(), as.pacer.text());
+
+        for (size_t i = 0; i < lines.size(); i++) {
+            glm::vec2 pos{OVERLAY_FONT_WIDTH, OVERLAY_FONT_WIDTH * static_cast<float>(i + 1)};
+            as.text_batch.add(as.font, lines[i], pos, OVERLAY_TEXT_STYLE);
+        }
+
+        as.text_batch.flush(as.font_shader, as.font);
+    }
+
+    as.pacer.wait();
     SDL_GL_SwapWindow(as.window);
 
+    if (as.latency_gpu_wait) {
+        glFinish();
+    }
+
+    uint64_t present_ns = SDL_GetTicksNS();
+    as.latency.end_frame(present_ns);
+    as.pacer.presented(present_ns, as.scheduler.rate == FrameRate::FULL);
+
+    // throttled frames are slow on purpose
+    float budget_ms = as.pacer.target_period_ms();
+    as.dynres.update(dt * 1000.f,
+                     budget_ms > 0 ? budget_ms : 1000.f / as.pacer.refresh_hz,
+                     as.scheduler.rate == FrameRate::FULL);
+
+    if (as.benchmark.enabled && as.benchmark.add_frame(dt * 1000.f)) {
+        as.benchmark.add_json("renderer",
+                              json_string(as.shape_shader.renderer == ShapeRenderer::MESH ? "mesh" : "sdf"));
+        as.benchmark.add_json("msaa", json_bool(as.msaa));
+        as.benchmark.add_json("feather", json_bool(!as.msaa));
+        as.benchmark.add_json("short_vertex", json_bool(SHAPE_SHORT_VERTEX));
+
+        // the shape set numbers are in the log, see make_shape_set
+        Arena arena(GEOMETRY_ARENA_BYTES);
+        as.benchmark.add_json("mesh_optimize_quad_grid", optimize_quad_grid(arena).json());
+        as.benchmark.add_number("shape_set_heap_allocations", static_cast<double>(as.shape_set_allocations));
+
+        as.benchmark.add_number("display_width", static_cast<double>(as.view.uniform.display_width));
+        as.benchmark.add_number(
+            "hit_test_queries_per_sec",
+            benchmark_hit_grid(as.dst_hit, draw_area(), BENCHMARK_HIT_TEST_QUERIES, as.view.uniform.time));
+        as.benchmark.add_number("hit_test_64_queries_per_sec", benchmark_hit_test(as));
+        as.benchmark.add_number("coalesced_motion_events", static_cast<double>(as.coalesced_motion));
+        as.benchmark.add_json("input_latency_ms", as.latency.stats.json());
+        as.benchmark.add_json("latency_gpu_wait", json_bool(as.latency_gpu_wait));
+        as.benchmark.add_json("frame_pacing", as.pacer.json());
+        as.benchmark.add_json("layer_cache", json_bool(as.layer_cache.enabled));
+        as.benchmark.add_number("layer_cache_rebuilds", static_cast<double>(as.layer_cache.rebuilds));
+        as.benchmark.add_json("render_queue", as.shape_queue.stats.json());
+        as.benchmark.add_json("dynamic_resolution", as.dynres.json());
+        as.benchmark.write(as.pref_path + "benchmark.json");
+
+        return SDL_APP_SUCCESS;
+    }
+
     return SDL_APP_CONTINUE;
 }
@@ -0,0 +1,385 @@
+#include "mesh_optimize.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <sstream>
+
+#include "gl_helper.hpp"
+
+namespace {
+// Forsyth's tuning constants, see "Linear-Speed Vertex Cache Optimisation"
+constexpr size_t FORSYTH_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRI_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+float vertex_score(int cache_pos, size_t valence) {
+    if (valence == 0) {
+        return -1.0f;  // no triangles left using it
+    }
+
+    float score = 0.0f;
+
+    if (cache_pos >= 0) {
+        if (cache_pos < 3) {
+            // used by the last triangle, don't favour it so strips don't get stuck
+            score = LAST_TRI_SCORE;
+        } else {
+            float scale = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - static_cast<float>(cache_pos - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+
+    // prefer vertices with few triangles left, so they get finished off
+    score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(valence), -VALENCE_BOOST_POWER);
+
+    return score;
+}
+}  // namespace
+
+float MeshOptimizeStats::acmr_before() const {
+    return triangle ? static_cast<float>(cache_miss_before) / static_cast<float>(triangle) : 0.0f;
+}
+
+float MeshOptimizeStats::acmr_after() const {
+    return triangle ? static_cast<float>(cache_miss_after) / static_cast<float>(triangle) : 0.0f;
+}
+
+MeshOptimizeStats &MeshOptimizeStats::operator+=(const MeshOptimizeStats &rhs) {
+    mesh += rhs.mesh;
+    vertex_before += rhs.vertex_before;
+    vertex_after += rhs.vertex_after;
+    triangle += rhs.triangle;
+    cache_miss_before += rhs.cache_miss_before;
+    cache_miss_after += rhs.cache_miss_after;
+
+    return *this;
+}
+
+std::string MeshOptimizeStats::json() const {
+    std::ostringstream ss;
+
+    ss << "{\"mesh\": " << mesh << ", \"vertex_before\": " << vertex_before << ", \"vertex_after\": " << vertex_after
+       << ", \"acmr_before\": " << acmr_before() << ", \"acmr_after\": " << acmr_after() << "}";
+
+    return ss.str();
+}
+
+void weld_vertex(Arena &arena, VertexIndex &mesh, float epsilon) {
+    ArenaScope scope(arena);
+
+    // Quantize to an epsilon grid and merge on equal keys, found by sorting.
+    // Two vertices straddling a grid line won't merge, fine for generated meshes where duplicates are exact.
+    using Key = std::array<int64_t, 5>;
+
+    auto q = [=](float x) { return static_cast<int64_t>(std::llround(x / epsilon)); };
+
+    size_t n = mesh.vertex.size();
+
+    std::span<Key> key = arena.alloc<Key>(n);
+    std::span<uint32_t> order = arena.alloc<uint32_t>(n);
+    std::span<uint32_t> remap = arena.alloc<uint32_t>(n);
+
+    for (size_t i = 0; i < n; i++) {
+        const ShapeVertex &v = mesh.vertex[i];
+        key[i] = {q(v.pos.x), q(v.pos.y), q(v.extrude.x), q(v.extrude.y), q(v.coverage)};
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    // ties broken by index, so the first vertex of each run is the one that's kept
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return key[a] != key[b] ? key[a] < key[b] : a < b;
+    });
+
+    for (size_t i = 0; i < n; i++) {
+        bool first = i == 0 || key[order[i]] != key[order[i - 1]];
+        remap[order[i]] = first ? order[i] : remap[order[i - 1]];
+    }
+
+    // compact in place, kept vertices only move down
+    size_t kept = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (remap[i] == i) {
+            mesh.vertex[kept] = mesh.vertex[i];
+            remap[i] = static_cast<uint32_t>(kept++);
+        } else {
+            remap[i] = remap[remap[i]];
+        }
+    }
+
+    for (auto &i : mesh.index) {
+        if (i != PRIMITIVE_RESTART_INDEX) {
+            i = remap[i];
+        }
+    }
+
+    mesh.vertex = mesh.vertex.first(kept);
+}
+
+void optimize_vertex_cache(Arena &arena, VertexIndex &mesh) {
+    if (mesh.mode != GL_TRIANGLES) {
+        return;
+    }
+
+    ArenaScope scope(arena);
+
+    size_t num_tri = mesh.index.size() / 3;
+    size_t num_vert = mesh.vertex.size();
+
+    // Triangles using each vertex, packed into one array.
+    // vert_tri[vert_tri_start[v], + vert_valence[v]) are the triangles of v not emitted yet.
+    std::span<uint32_t> vert_valence = arena.alloc<uint32_t>(num_vert);
+    std::span<uint32_t> vert_tri_start = arena.alloc<uint32_t>(num_vert);
+    std::span<uint32_t> vert_tri = arena.alloc<uint32_t>(num_tri * 3);
+
+    std::fill(vert_valence.begin(), vert_valence.end(), 0);
+
+    for (uint32_t i : mesh.index) {
+        vert_valence[i]++;
+    }
+
+    uint32_t start = 0;
+    for (size_t v = 0; v < num_vert; v++) {
+        vert_tri_start[v] = start;
+        start += vert_valence[v];
+        vert_valence[v] = 0;
+    }
+
+    for (uint32_t t = 0; t < num_tri; t++) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = mesh.index[t * 3 + k];
+            vert_tri[vert_tri_start[v] + vert_valence[v]++] = t;
+        }
+    }
+
+    auto tri_of = [&](uint32_t v) { return vert_tri.subspan(vert_tri_start[v], vert_valence[v]); };
+
+    std::span<int> cache_pos = arena.alloc<int>(num_vert);
+    std::span<float> vert_score = arena.alloc<float>(num_vert);
+
+    for (size_t v = 0; v < num_vert; v++) {
+        cache_pos[v] = -1;
+        vert_score[v] = vertex_score(-1, vert_valence[v]);
+    }
+
+    std::span<uint8_t> emitted = arena.alloc<uint8_t>(num_tri);
+    std::span<float> tri_score = arena.alloc<float>(num_tri);
+
+    std::fill(emitted.begin(), emitted.end(), 0);
+
+    auto update_tri_score = [&](uint32_t t) {
+        tri_score[t] = vert_score[mesh.index[t * 3]] + vert_score[mesh.index[t * 3 + 1]] +
+                       vert_score[mesh.index[t * 3 + 2]];
+    };
+
+    for (uint32_t t = 0; t < num_tri; t++) {
+        update_tri_score(t);
+    }
+
+    // LRU, most recent first, with room for the 3 vertices pushed in before trimming
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3> cache;
+    size_t cache_size = 0;
+
+    std::span<uint32_t> out = arena.alloc<uint32_t>(num_tri * 3);
+    size_t out_size = 0;
+
+    for (size_t n = 0; n < num_tri; n++) {
+        // best triangle touching the cache, or a full scan when the cache has nothing left
+        std::optional<uint32_t> best;
+
+        for (size_t c = 0; c < cache_size; c++) {
+            for (uint32_t t : tri_of(cache[c])) {
+                if (!best || tri_score[t] > tri_score[*best]) {
+                    best = t;
+                }
+            }
+        }
+
+        if (!best) {
+            for (uint32_t t = 0; t < num_tri; t++) {
+                if (!emitted[t] && (!best || tri_score[t] > tri_score[*best])) {
+                    best = t;
+                }
+            }
+        }
+
+        uint32_t t = *best;
+        emitted[t] = 1;
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = mesh.index[t * 3 + k];
+            out[out_size++] = v;
+
+            // swap remove t from the live triangles of v
+            std::span<uint32_t> tri = tri_of(v);
+            std::swap(*std::find(tri.begin(), tri.end(), t), tri.back());
+            vert_valence[v]--;
+
+            // move v to the front of the cache
+            auto end = cache.begin() + static_cast<std::ptrdiff_t>(cache_size);
+            auto it = std::find(cache.begin(), end, v);
+
+            if (it == end) {
+                cache_size++;
+            }
+
+            std::copy_backward(cache.begin(), it, it + 1);
+            cache[0] = v;
+        }
+
+        // vertices pushed out of the cache lose their cache score
+        size_t touched = cache_size;
+
+        for (size_t c = 0; c < cache_size; c++) {
+            cache_pos[cache[c]] = c < FORSYTH_CACHE_SIZE ? static_cast<int>(c) : -1;
+        }
+
+        for (size_t c = 0; c < touched; c++) {
+            vert_score[cache[c]] = vertex_score(cache_pos[cache[c]], vert_valence[cache[c]]);
+        }
+
+        for (size_t c = 0; c < touched; c++) {
+            for (uint32_t tt : tri_of(cache[c])) {
+                update_tri_score(tt);
+            }
+        }
+
+        cache_size = std::min(cache_size, FORSYTH_CACHE_SIZE);
+    }
+
+    std::copy(out.begin(), out.end(), mesh.index.begin());
+}
+
+void optimize_vertex_fetch(Arena &arena, VertexIndex &mesh) {
+    ArenaScope scope(arena);
+
+    constexpr uint32_t unused = 0xffffffff;
+
+    std::span<uint32_t> remap = arena.alloc<uint32_t>(mesh.vertex.size());
+    std::span<ShapeVertex> vertex = arena.alloc<ShapeVertex>(mesh.vertex.size());
+    size_t count = 0;
+
+    std::fill(remap.begin(), remap.end(), unused);
+
+    for (auto &i : mesh.index) {
+        if (i == PRIMITIVE_RESTART_INDEX) {
+            continue;
+        }
+
+        if (remap[i] == unused) {
+            remap[i] = static_cast<uint32_t>(count);
+            vertex[count++] = mesh.vertex[i];
+        }
+
+        i = remap[i];
+    }
+
+    std::copy(vertex.begin(), vertex.begin() + static_cast<std::ptrdiff_t>(count), mesh.vertex.begin());
+    mesh.vertex = mesh.vertex.first(count);
+}
+
+size_t count_cache_miss(std::span<const uint32_t> index, size_t cache_size) {
+    // ring buffer FIFO
+    std::array<uint32_t, 64> fifo;
+    size_t head = 0;
+    size_t size = 0;
+    size_t miss = 0;
+
+    assert(cache_size <= fifo.size());
+
+    for (uint32_t i : index) {
+        bool hit = false;
+
+        for (size_t c = 0; c < size; c++) {
+            if (fifo[(head + c) % cache_size] == i) {
+                hit = true;
+                break;
+            }
+        }
+
+        if (hit) {
+            continue;
+        }
+
+        miss++;
+
+        if (size < cache_size) {
+            fifo[(head + size++) % cache_size] = i;
+        } else {
+            fifo[head] = i;
+            head = (head + 1) % cache_size;
+        }
+    }
+
+    return miss;
+}
+
+MeshOptimizeStats optimize_mesh(Arena &arena, VertexIndex &mesh) {
+    MeshOptimizeStats stats;
+
+    stats.mesh = 1;
+    stats.vertex_before = mesh.vertex.size();
+
+    if (mesh.mode == GL_TRIANGLES) {
+        stats.triangle = mesh.index.size() / 3;
+        stats.cache_miss_before = count_cache_miss(mesh.index);
+    }
+
+    weld_vertex(arena, mesh);
+    optimize_vertex_cache(arena, mesh);
+    optimize_vertex_fetch(arena, mesh);
+
+    if (mesh.mode == GL_TRIANGLES) {
+        stats.cache_miss_after = count_cache_miss(mesh.index);
+    }
+
+    stats.vertex_after = mesh.vertex.size();
+
+    return stats;
+}
+
+MeshOptimizeStats optimize_quad_grid(Arena &arena, size_t quads_per_side) {
+    ArenaScope scope(arena);
+
+    size_t n = quads_per_side;
+    std::span<uint32_t> order = arena.alloc<uint32_t>(n * n);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    std::mt19937 g(1);
+    std::shuffle(order.begin(), order.end(), g);
+
+    VertexIndex mesh;
+    mesh.vertex = arena.alloc<ShapeVertex>(n * n * 4);
+    mesh.index = arena.alloc<uint32_t>(n * n * 6);
+
+    for (size_t i = 0; i < order.size(); i++) {
+        float x = static_cast<float>(order[i] % n);
+        float y = static_cast<float>(order[i] / n);
+
+        std::span<ShapeVertex> v = mesh.vertex.subspan(i * 4, 4);
+        v[0].pos = {x, y};
+        v[1].pos = {x + 1, y};
+        v[2].pos = {x + 1, y + 1};
+        v[3].pos = {x, y + 1};
+
+        auto first = static_cast<uint32_t>(i * 4);
+        std::span<uint32_t> idx = mesh.index.subspan(i * 6, 6);
+        idx[0] = first;
+        idx[1] = first + 1;
+        idx[2] = first + 2;
+        idx[3] = first;
+        idx[4] = first + 2;
+        idx[5] = first + 3;
+    }
+
+    return optimize_mesh(arena, mesh);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "arena.hpp"
+#include "geometry.hpp"
+
+// Post-process for generated or imported meshes, run once when the mesh is built.
+// Works in place, scratch memory comes from the arena and is given back on return.
+
+struct MeshOptimizeStats {
+    size_t mesh = 0;
+    size_t vertex_before = 0;
+    size_t vertex_after = 0;
+
+    // only GL_TRIANGLES meshes count towards the ACMR, strips are in cache order already
+    size_t triangle = 0;
+    size_t cache_miss_before = 0;
+    size_t cache_miss_after = 0;
+
+    float acmr_before() const;
+    float acmr_after() const;
+
+    MeshOptimizeStats &operator+=(const MeshOptimizeStats &rhs);
+
+    // {"mesh": ..., "vertex_before": ..., "vertex_after": ..., "acmr_before": ..., "acmr_after": ...}
+    std::string json() const;
+};
+
+// Size of the FIFO post-transform cache used to measure ACMR (average cache miss ratio, misses per triangle).
+// Mobile GPUs are somewhere between 8 and 32.
+constexpr size_t MESH_CACHE_SIZE = 16;
+
+// Merge vertices whose attributes are all within epsilon of each other
+void weld_vertex(Arena &arena, VertexIndex &mesh, float epsilon = 1e-5f);
+
+// Reorder the triangles of a GL_TRIANGLES mesh for post-transform cache hits, Forsyth's algorithm
+void optimize_vertex_cache(Arena &arena, VertexIndex &mesh);
+
+// Renumber vertices in order of first use, so vertex fetch walks the buffer forward. Drops unused vertices.
+void optimize_vertex_fetch(Arena &arena, VertexIndex &mesh);
+
+// Number of FIFO cache misses when drawing a GL_TRIANGLES index buffer, cache_size is at most 64
+size_t count_cache_miss(std::span<const uint32_t> index, size_t cache_size = MESH_CACHE_SIZE);
+
+// All of the above
+MeshOptimizeStats optimize_mesh(Arena &arena, VertexIndex &mesh);
+
+// Reference case for --benchmark: a grid of quads in shuffled order, each quad with its own 4 vertices like an
+// unwelded export. The shuffle has a fixed seed so every run gives the same numbers.
+MeshOptimizeStats optimize_quad_grid(Arena &arena, size_t quads_per_side = 20);
@@ -0,0 +1,12 @@
+#include "render_queue.hpp"
+
+#include <sstream>
+
+std::string RenderQueueStats::json() const {
+    std::ostringstream ss;
+
+    ss << "{\"draws\": " << draws << ", \"program_changes\": " << program_changes
+       << ", \"mesh_changes\": " << mesh_changes << "}";
+
+    return ss.str();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Draws are submitted with a 64 bit sort key and executed in key order at the end of the frame, so draws sharing a
+// program, texture and mesh end up next to each other. Most significant first:
+//
+//   layer 4 | order 20 | program 8 | texture 8 | mesh 16 | unused 8
+//
+// order is the submission sequence in ordered layers, where blending needs draws to stay in the order they were
+// submitted, and 0 in the others. The GL names are truncated to fit, a clash only costs a state change.
+
+enum class RenderLayer : uint8_t {
+    BOARD_FILL,  // shapes on the board don't overlap each other, so any order within the layer is fine
+    BOARD_LINE,  // outlines go over the fills
+    DRAGGED,     // ordered, dragged shapes can overlap anything
+};
+
+constexpr bool is_ordered(RenderLayer layer) { return layer == RenderLayer::DRAGGED; }
+
+constexpr uint64_t make_sort_key(RenderLayer layer, uint32_t order, uint32_t program, uint32_t texture, uint32_t mesh) {
+    return (static_cast<uint64_t>(layer) & 0xf) << 60 | (static_cast<uint64_t>(order) & 0xfffff) << 40 |
+           (static_cast<uint64_t>(program) & 0xff) << 32 | (static_cast<uint64_t>(texture) & 0xff) << 24 |
+           (static_cast<uint64_t>(mesh) & 0xffff) << 8;
+}
+
+struct RenderCommand {
+    uint64_t key;
+    uint32_t draw;  // index into RenderQueue::draw
+};
+
+// Changes made while executing the last queue, for profiling
+struct RenderQueueStats {
+    uint32_t draws = 0;
+    uint32_t program_changes = 0;
+    uint32_t mesh_changes = 0;
+
+    // {"draws": ..., "program_changes": ..., "mesh_changes": ...}
+    std::string json() const;
+};
+
+// DRAW is whatever the executor needs for one draw call, the queue only orders them.
+// Storage is kept between frames to avoid allocating every frame.
+template <typename DRAW>
+struct RenderQueue {
+    std::vector<RenderCommand> command;
+    std::vector<DRAW> draw;
+    uint32_t num_ordered = 0;  // order given to the next draw in an ordered layer
+
+    RenderQueueStats stats;
+
+    void submit(RenderLayer layer, uint32_t program, uint32_t texture, uint32_t mesh, const DRAW &d) {
+        uint32_t order = is_ordered(layer) ? num_ordered++ : 0;
+        auto idx = static_cast<uint32_t>(draw.size());
+
+        command.push_back({make_sort_key(layer, order, program, texture, mesh), idx});
+        draw.push_back(d);
+    }
+
+    // Ties keep the submission order, which makes the frame the same from one run to the next
+    void sort() {
+        std::sort(command.begin(), command.end(), [](const RenderCommand &a, const RenderCommand &b) {
+            return a.key != b.key ? a.key < b.key : a.draw < b.draw;
+        });
+    }
+
+    void clear() {
+        command.clear();
+        draw.clear();
+        num_ordered = 0;
+    }
+};
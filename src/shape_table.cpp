@@ -0,0 +1,232 @@
+#include "shape_table.hpp"
+
+#include <utility>
+
+#include "gl_helper.hpp"
+
+// Compile time version of make_polygon, make_fill and make_line (see geometry.cpp) for the built-in shapes.
+// Only the default format is covered, make_shape_set falls back to the runtime builders for anything else.
+// Keep the two in sync.
+
+namespace {
+struct Vec2 {
+    double x = 0;
+    double y = 0;
+};
+
+constexpr Vec2 operator+(Vec2 a, Vec2 b) { return {a.x + b.x, a.y + b.y}; }
+constexpr Vec2 operator-(Vec2 a, Vec2 b) { return {a.x - b.x, a.y - b.y}; }
+constexpr Vec2 operator-(Vec2 a) { return {-a.x, -a.y}; }
+constexpr Vec2 operator*(Vec2 a, double s) { return {a.x * s, a.y * s}; }
+constexpr double dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+constexpr Vec2 normalize(Vec2 a) { return a * (1.0 / cx::sqrt(dot(a, a))); }
+
+// same as geometry.cpp
+constexpr double MITER_LIMIT = 4.0;
+
+template <size_t N>
+constexpr std::array<Vec2, N> outline_vert(const Outline &o) {
+    std::array<Vec2, N> ret{};
+
+    for (size_t i = 0; i < N; i++) {
+        double theta = static_cast<double>(i) * 2 * cx::PI / static_cast<double>(N);
+        double r = i % 2 == 0 ? o.r0 : o.r1;
+
+        ret[i] = {r * cx::cos(theta) * o.sx, r * cx::sin(theta) * o.sy};
+    }
+
+    return ret;
+}
+
+template <size_t N>
+constexpr double winding(const std::array<Vec2, N> &vert) {
+    double area = 0;
+
+    for (size_t i = 0; i < N; i++) {
+        const Vec2 &a = vert[i];
+        const Vec2 &b = vert[(i + 1) % N];
+        area += a.x * b.y - a.y * b.x;
+    }
+
+    return area >= 0 ? 1.0 : -1.0;
+}
+
+struct Corner {
+    Vec2 n0, n1;
+    Vec2 miter;
+    bool convex = false;
+    bool bevel = false;
+};
+
+template <size_t N>
+constexpr Corner corner(const std::array<Vec2, N> &vert, size_t i) {
+    double sign = winding(vert);
+
+    Vec2 e0 = normalize(vert[i] - vert[(i + N - 1) % N]);
+    Vec2 e1 = normalize(vert[(i + 1) % N] - vert[i]);
+
+    Corner c;
+    c.n0 = Vec2{e0.y, -e0.x} * sign;
+    c.n1 = Vec2{e1.y, -e1.x} * sign;
+
+    Vec2 m = normalize(c.n0 + c.n1);
+    double cos_half = dot(m, c.n1);
+
+    c.miter = m * (1.0 / (cos_half > 1.0 / MITER_LIMIT ? cos_half : 1.0 / MITER_LIMIT));
+    c.convex = (e0.x * e1.y - e0.y * e1.x) * sign > 0;
+    c.bevel = cos_half < 1.0 / MITER_LIMIT;
+
+    return c;
+}
+
+template <size_t V, size_t I>
+struct MeshData {
+    std::array<ShortShapeVertex, V> vertex{};
+    std::array<uint16_t, I> index{};
+
+    static_assert(V < 0xffff, "too many vertices for 16 bit indices");
+};
+
+constexpr ShortShapeVertex pack(Vec2 pos, Vec2 extrude, double coverage) {
+    auto f = [](double x) { return static_cast<float>(x); };
+
+    return {{quantize_snorm(f(pos.x)), quantize_snorm(f(pos.y))},
+            {quantize_snorm(f(extrude.x)), quantize_snorm(f(extrude.y))},
+            quantize_unorm(f(coverage)),
+            {}};
+}
+
+// make_fill with feather
+template <size_t N>
+constexpr MeshData<N * 2 + 1, N * 9> make_fill(const std::array<Vec2, N> &vert) {
+    MeshData<N * 2 + 1, N * 9> ret;
+
+    size_t outer = N + 1;
+    size_t idx = 0;
+
+    for (size_t i = 0; i < N; i++) {
+        Corner c = corner(vert, i);
+
+        ret.vertex[i] = pack(vert[i], -c.miter * 0.5, 1.0);
+        ret.vertex[outer + i] = pack(vert[i], c.miter * 0.5, 0.0);
+    }
+
+    ret.vertex[N] = pack({}, {}, 1.0);
+
+    for (size_t i = 0; i < N; i++) {
+        size_t j = (i + 1) % N;
+
+        for (size_t k : {i, j, N}) {
+            ret.index[idx++] = static_cast<uint16_t>(k);
+        }
+    }
+
+    for (size_t i = 0; i < N; i++) {
+        size_t j = (i + 1) % N;
+
+        for (size_t k : {i, j, outer + j, i, outer + j, outer + i}) {
+            ret.index[idx++] = static_cast<uint16_t>(k);
+        }
+    }
+
+    return ret;
+}
+
+template <size_t N>
+constexpr size_t line_sample_count(const std::array<Vec2, N> &vert) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < N; i++) {
+        count += corner(vert, i).bevel ? 2 : 1;
+    }
+
+    return count;
+}
+
+constexpr size_t LINE_RINGS = 4;  // with feather
+
+constexpr size_t line_index_count(size_t samples) { return (LINE_RINGS - 1) * (samples + 1) * 2 + (LINE_RINGS - 2); }
+
+// make_line with feather and LineJoin::MITER
+template <size_t S, size_t N>
+constexpr MeshData<S * LINE_RINGS, line_index_count(S)> make_line(const std::array<Vec2, N> &vert, double thickness) {
+    MeshData<S * LINE_RINGS, line_index_count(S)> ret;
+
+    double half = thickness * 0.5;
+    size_t v = 0;
+
+    auto add_sample = [&](Vec2 p, Vec2 outer_n, Vec2 inner_n) {
+        Vec2 outer = p + outer_n * half;
+        Vec2 inner = p - inner_n * half;
+
+        ret.vertex[v++] = pack(outer, outer_n * 0.5, 0.0);
+        ret.vertex[v++] = pack(outer, -outer_n * 0.5, 1.0);
+        ret.vertex[v++] = pack(inner, inner_n * 0.5, 1.0);
+        ret.vertex[v++] = pack(inner, -inner_n * 0.5, 0.0);
+    };
+
+    for (size_t i = 0; i < N; i++) {
+        Corner c = corner(vert, i);
+
+        if (!c.bevel) {
+            add_sample(vert[i], c.miter, c.miter);
+        } else if (c.convex) {
+            add_sample(vert[i], c.n0, c.miter);
+            add_sample(vert[i], c.n1, c.miter);
+        } else {
+            add_sample(vert[i], c.miter, c.n0);
+            add_sample(vert[i], c.miter, c.n1);
+        }
+    }
+
+    size_t idx = 0;
+
+    for (size_t r = 0; r + 1 < LINE_RINGS; r++) {
+        if (r > 0) {
+            ret.index[idx++] = 0xffff;  // PRIMITIVE_RESTART_INDEX for 16 bit
+        }
+
+        for (size_t i = 0; i <= S; i++) {
+            size_t base = (i % S) * LINE_RINGS + r;
+            ret.index[idx++] = static_cast<uint16_t>(base);
+            ret.index[idx++] = static_cast<uint16_t>(base + 1);
+        }
+    }
+
+    return ret;
+}
+
+template <size_t OUTLINE>
+struct BuiltinMesh {
+    static constexpr Outline outline = BUILTIN_OUTLINE[OUTLINE];
+    static constexpr auto vert = outline_vert<static_cast<size_t>(outline.sides)>(outline);
+    static constexpr size_t samples = line_sample_count(vert);
+
+    static constexpr auto fill = make_fill(vert);
+    static constexpr auto line = make_line<samples>(vert, SHAPE_LINE_THICKNESS);
+    static constexpr auto line_highlight = make_line<samples>(vert, SHAPE_LINE_THICKNESS * 2);
+};
+
+template <size_t OUTLINE>
+constexpr StaticShapeMesh static_shape_mesh() {
+    using M = BuiltinMesh<OUTLINE>;
+
+    return {
+        {M::fill.vertex, M::fill.index, GL_TRIANGLES},
+        {M::line.vertex, M::line.index, GL_TRIANGLE_STRIP},
+        {M::line_highlight.vertex, M::line_highlight.index, GL_TRIANGLE_STRIP},
+    };
+}
+
+template <size_t... OUTLINE>
+constexpr std::array<StaticShapeMesh, sizeof...(OUTLINE)> make_table(std::index_sequence<OUTLINE...>) {
+    return {static_shape_mesh<OUTLINE>()...};
+}
+
+constexpr std::array<StaticShapeMesh, NUM_OUTLINE> BUILTIN_SHAPE_MESH =
+    make_table(std::make_index_sequence<NUM_OUTLINE>());
+
+static_assert(static_cast<uint16_t>(PRIMITIVE_RESTART_INDEX) == 0xffff);
+}  // namespace
+
+const StaticShapeMesh &builtin_shape_mesh(size_t outline) { return BUILTIN_SHAPE_MESH.at(outline); }
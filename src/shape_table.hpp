@@ -0,0 +1,102 @@
+#pragma once
+
+#include <SDL3/SDL_opengles2.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "constexpr_math.hpp"
+
+// Built-in shape outlines and their meshes generated at compile time, see shape_table.cpp
+
+// ShapeMeshFormat::short_vertex, pos and extrude are divided by SHORT_VERTEX_RANGE
+// Everything fits with room to spare, the highlight line reaches 1.4 with the miter limit.
+constexpr float SHORT_VERTEX_RANGE = 2.0f;
+
+struct ShortShapeVertex {
+    int16_t pos[2];
+    int16_t extrude[2];
+    uint8_t coverage;
+    uint8_t padding[3];  // keep the stride 4 byte aligned
+};
+
+static_assert(sizeof(ShortShapeVertex) == 12);
+
+constexpr int16_t quantize_snorm(float x) {
+    double v = cx::clamp(static_cast<double>(x) / SHORT_VERTEX_RANGE, -1.0, 1.0);
+    return static_cast<int16_t>(cx::round(v * 32767.0));
+}
+
+constexpr uint8_t quantize_unorm(float x) {
+    return static_cast<uint8_t>(cx::round(cx::clamp(static_cast<double>(x), 0.0, 1.0) * 255.0));
+}
+
+constexpr float SHAPE_LINE_THICKNESS = 0.1f;  // normalized, the highlight line is twice as thick
+
+// Segment counts for the curved shape lods, 8 segments is good for up to ~13 pixels radius, 128 up to ~1600
+constexpr int LOD_SEGMENTS[] = {8, 12, 16, 24, 32, 48, 64, 96, 128};
+constexpr size_t NUM_LOD = std::size(LOD_SEGMENTS);
+
+// Vertex i at angle i*2pi/sides with radius r0 (even i) or r1 (odd i), then scaled by (sx, sy)
+struct Outline {
+    int sides;
+    float r0 = 1.0f;
+    float r1 = 1.0f;
+    float sx = 1.0f;
+    float sy = 1.0f;
+};
+
+// Indices into BUILTIN_OUTLINE
+constexpr size_t OUTLINE_POLYGON = 0;  // 3 to 9 sides
+constexpr size_t OUTLINE_CIRCLE = 7;
+constexpr size_t OUTLINE_OVAL = 8;
+constexpr size_t OUTLINE_STAR = 9;  // 4 of them
+constexpr size_t OUTLINE_RHOMBUS = 13;
+constexpr size_t OUTLINE_CIRCLE_LOD = 14;  // NUM_LOD of them
+constexpr size_t OUTLINE_OVAL_LOD = OUTLINE_CIRCLE_LOD + NUM_LOD;
+constexpr size_t NUM_OUTLINE = OUTLINE_OVAL_LOD + NUM_LOD;
+
+constexpr std::array<Outline, NUM_OUTLINE> make_builtin_outline() {
+    std::array<Outline, NUM_OUTLINE> ret{};
+
+    for (int sides = 3; sides <= 9; sides++) {
+        ret[OUTLINE_POLYGON + static_cast<size_t>(sides - 3)] = {sides};
+    }
+
+    ret[OUTLINE_CIRCLE] = {36};
+    ret[OUTLINE_OVAL] = {36, 1.0f, 1.0f, 1.0f, 0.5f};
+
+    for (int i = 0; i < 4; i++) {
+        ret[OUTLINE_STAR + static_cast<size_t>(i)] = {8 + i * 2, 1.0f, 0.5f};
+    }
+
+    ret[OUTLINE_RHOMBUS] = {4, 1.0f, 0.8f};
+
+    for (size_t i = 0; i < NUM_LOD; i++) {
+        ret[OUTLINE_CIRCLE_LOD + i] = {LOD_SEGMENTS[i]};
+        ret[OUTLINE_OVAL_LOD + i] = {LOD_SEGMENTS[i], 1.0f, 1.0f, 1.0f, 0.5f};
+    }
+
+    return ret;
+}
+
+constexpr std::array<Outline, NUM_OUTLINE> BUILTIN_OUTLINE = make_builtin_outline();
+
+// A mesh in read-only memory, ready to upload as is
+struct StaticMesh {
+    std::span<const ShortShapeVertex> vertex;
+    std::span<const uint16_t> index;
+    GLenum mode;
+};
+
+struct StaticShapeMesh {
+    StaticMesh fill;
+    StaticMesh line;
+    StaticMesh line_highlight;
+};
+
+// Meshes of BUILTIN_OUTLINE[outline] with line thickness SHAPE_LINE_THICKNESS, in the
+// ShapeMeshFormat{feather = true, short_vertex = true, line_join = MITER} format.
+const StaticShapeMesh &builtin_shape_mesh(size_t outline);
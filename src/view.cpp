@@ -0,0 +1,30 @@
+#include "view.hpp"
+
+#include <cstddef>
+
+bool View::init() {
+    buffer = make_uniform_buffer(sizeof(ViewUniform), VIEW_UNIFORM_BINDING);
+
+    if (!buffer) {
+        return false;
+    }
+
+    update();
+
+    return true;
+}
+
+void View::update() const { buffer->update(&uniform, sizeof(uniform)); }
+
+void View::update_time(float time) {
+    uniform.time = time;
+    buffer->update(&uniform.time, sizeof(uniform.time), offsetof(ViewUniform, time));
+}
+
+glm::vec2 normalize_pos_to_screen_pos(const View &view, const glm::vec2 &pos) {
+    return view.uniform.draw_area_offset + pos * view.uniform.draw_area_size.x;
+}
+
+glm::vec2 screen_pos_to_normalize_pos(const View &view, const glm::vec2 &pos) {
+    return (pos - view.uniform.draw_area_offset) / view.uniform.draw_area_size.x;
+}
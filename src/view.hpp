@@ -0,0 +1,45 @@
+#pragma once
+
+#include <SDL3/SDL_opengles2.h>
+
+#include <glm/glm.hpp>
+
+#include "gl_helper.hpp"
+
+// View level constants shared by all the shaders through one std140 uniform block.
+// Programs pick it up with Shader::bind_uniform_block("View", VIEW_UNIFORM_BINDING).
+constexpr GLuint VIEW_UNIFORM_BINDING = 0;
+
+// Paste into the shader source after the precision statement.
+// Must match the layout of ViewUniform.
+#define VIEW_UNIFORM_GLSL                                                    \
+    "layout(std140) uniform View {\n"                                        \
+    "    highp mat4 ortho_matrix;\n"                                         \
+    "    highp vec2 draw_area_offset; // screen pixel units\n"               \
+    "    highp vec2 draw_area_size; // screen pixel units\n"                 \
+    "    highp float display_width; // draw area width in screen pixels\n"   \
+    "    highp float time; // seconds\n"                                     \
+    "};\n"
+
+struct ViewUniform {
+    glm::mat4 ortho{1.0f};
+    glm::vec2 draw_area_offset{};
+    glm::vec2 draw_area_size{};
+    float display_width = 1.0f;
+    float time = 0.0f;
+    float padding[2]{};  // std140 rounds the block up to a vec4
+};
+
+static_assert(sizeof(ViewUniform) == 96, "ViewUniform must match the std140 layout of VIEW_UNIFORM_GLSL");
+
+struct View {
+    ViewUniform uniform;
+    UniformBufferPtr buffer{{}, {}};
+
+    bool init();
+    void update() const;  // upload all of uniform, call after changing it (e.g. window resize)
+    void update_time(float time);
+};
+
+glm::vec2 normalize_pos_to_screen_pos(const View &view, const glm::vec2 &pos);
+glm::vec2 screen_pos_to_normalize_pos(const View &view, const glm::vec2 &pos);